@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <mutex>
 #include <condition_variable>
@@ -35,6 +36,18 @@ public:
     bool offer(const T t, std::chrono::milliseconds& time);
     bool poll(T& t, std::chrono::milliseconds& time);
 
+    // batch api: a whole batch under one lock acquisition and one notification
+    // put_many blocks while the queue is full (a batch larger than the free space goes in chunks)
+    void put_many(const T* items, size_t n);
+    void put_many(const std::vector<T>& items) { put_many(items.data(), items.size()); }
+    // append up to n items to out, non-blocking
+    size_t drain_up_to(std::vector<T>& out, size_t n);
+    // wait up to time for at least one item, then append up to n items to out
+    size_t drain(std::vector<T>& out, size_t n, std::chrono::milliseconds& time);
+    // same, but write the items to out[0, n), e.g. straight into a message buffer
+    size_t drain_up_to(T* out, size_t n);
+    size_t drain(T* out, size_t n, std::chrono::milliseconds& time);
+
     bool empty() const{
         std::lock_guard<std::mutex> lock(m_mutex);
         return m_sz_ == 0;
@@ -51,6 +64,9 @@ public:
     }
 
 private:
+    size_t drain_locked(std::vector<T>& out, size_t n);
+    size_t drain_locked(T* out, size_t n);
+
     std::vector<T> m_queue;
     const int m_maxCapacity;
     size_t m_head_ = 0, m_tail_ = 0;
@@ -138,6 +154,74 @@ bool BlockQueue<T>::poll(T& t, std::chrono::milliseconds& time){
     return true;
 }
 
+template <class T>
+void BlockQueue<T>::put_many(const T* items, size_t n){
+    while(n > 0){
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond_full.wait(lock, [this]{ return m_sz_ < m_maxCapacity; });
+        size_t cnt = std::min(n, (size_t)(m_maxCapacity - m_sz_));
+        for(size_t i = 0; i < cnt; i++){
+            m_queue[m_tail_] = items[i];
+            m_tail_ = (m_tail_ + 1) % m_maxCapacity;
+        }
+        m_sz_ += cnt;
+        items += cnt;
+        n -= cnt;
+        m_cond_empty.notify_all();
+    }
+}
+
+template <class T>
+size_t BlockQueue<T>::drain_locked(T* out, size_t n){
+    size_t cnt = std::min(n, (size_t)m_sz_);
+    for(size_t i = 0; i < cnt; i++){
+        out[i] = std::move(m_queue[m_head_]);
+        m_head_ = (m_head_ + 1) % m_maxCapacity;
+    }
+    m_sz_ -= cnt;
+    if(cnt != 0){
+        m_cond_full.notify_all();
+    }
+    return cnt;
+}
+
+template <class T>
+size_t BlockQueue<T>::drain_locked(std::vector<T>& out, size_t n){
+    size_t old_size = out.size();
+    out.resize(old_size + std::min(n, (size_t)m_sz_));
+    return drain_locked(out.data() + old_size, n);
+}
+
+template <class T>
+size_t BlockQueue<T>::drain_up_to(std::vector<T>& out, size_t n){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return drain_locked(out, n);
+}
+
+template <class T>
+size_t BlockQueue<T>::drain(std::vector<T>& out, size_t n, std::chrono::milliseconds& time){
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(!m_cond_empty.wait_for(lock, time, [&] {return m_sz_ > 0;})){
+        return 0;
+    }
+    return drain_locked(out, n);
+}
+
+template <class T>
+size_t BlockQueue<T>::drain_up_to(T* out, size_t n){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return drain_locked(out, n);
+}
+
+template <class T>
+size_t BlockQueue<T>::drain(T* out, size_t n, std::chrono::milliseconds& time){
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(!m_cond_empty.wait_for(lock, time, [&] {return m_sz_ > 0;})){
+        return 0;
+    }
+    return drain_locked(out, n);
+}
+
 
 
 template<class T>
@@ -163,6 +247,15 @@ public:
     bool offer(const T t, std::chrono::milliseconds& time);
     bool poll(T& t, std::chrono::milliseconds& time);
 
+    // batch api: a whole batch under one lock acquisition and one notification
+    // put_many blocks while the queue is full (a batch larger than the free space goes in chunks)
+    void put_many(const T* items, size_t n);
+    void put_many(const std::vector<T>& items) { put_many(items.data(), items.size()); }
+    // append up to n items to out, non-blocking
+    size_t drain_up_to(std::vector<T>& out, size_t n);
+    // wait up to time for at least one item, then append up to n items to out
+    size_t drain(std::vector<T>& out, size_t n, std::chrono::milliseconds& time);
+
     bool empty() const{
         std::lock_guard<std::mutex> lock(m_mutex);
         return m_queue.empty();
@@ -181,6 +274,8 @@ public:
     }
 
 private:
+    size_t drain_locked(std::vector<T>& out, size_t n);
+
     std::deque<T> m_queue;
     const int m_maxCapacity;
     mutable std::mutex m_mutex;
@@ -261,6 +356,50 @@ bool BlockQueueSTL<T>::poll(T& t, std::chrono::milliseconds& time){
     return true;
 }
 
+template <class T>
+void BlockQueueSTL<T>::put_many(const T* items, size_t n){
+    while(n > 0){
+        std::unique_lock<std::mutex> lock(m_mutex);
+        size_t cnt = n;
+        if(m_maxCapacity != -1){
+            m_cond_full.wait(lock, [this]{ return m_queue.size() < m_maxCapacity; });
+            cnt = std::min(n, m_maxCapacity - m_queue.size());
+        }
+        m_queue.insert(m_queue.end(), items, items + cnt);
+        items += cnt;
+        n -= cnt;
+        m_cond_empty.notify_all();
+    }
+}
+
+template <class T>
+size_t BlockQueueSTL<T>::drain_locked(std::vector<T>& out, size_t n){
+    size_t cnt = std::min(n, m_queue.size());
+    for(size_t i = 0; i < cnt; i++){
+        out.push_back(std::move(m_queue.front()));
+        m_queue.pop_front();
+    }
+    if(cnt != 0){
+        m_cond_full.notify_all();
+    }
+    return cnt;
+}
+
+template <class T>
+size_t BlockQueueSTL<T>::drain_up_to(std::vector<T>& out, size_t n){
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return drain_locked(out, n);
+}
+
+template <class T>
+size_t BlockQueueSTL<T>::drain(std::vector<T>& out, size_t n, std::chrono::milliseconds& time){
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if(!m_cond_empty.wait_for(lock, time, [&] {return !m_queue.empty();})){
+        return 0;
+    }
+    return drain_locked(out, n);
+}
+
 static void testBlockQueue(){
     auto produce = [](BlockQueue<int> &q) {
         const int num = 9;
@@ -3,15 +3,17 @@
 namespace ubiquant {
 
 // config init
+thread_local int Config::partition_idx = -1;
+thread_local std::string Config::trade_output_folder;
+thread_local std::string Config::snapshot_folder;
+
 std::string Config::data_folder;
-std::string Config::trade_output_folder;
 std::string Config::network_config_file = "/home/team-7/yzh/awsome-10w/network.host";
 
 int Config::sliding_window_size = 100;
 int Config::stock_num = 10;
 int Config::trader_num = 2;
 int Config::exchange_num = 2;
-int Config::partition_idx = -1;
 int Config::loader_nx_matrix = 500;
 int Config::loader_ny_matrix = 1000;
 int Config::loader_nz_matrix = 1000;
@@ -21,7 +23,43 @@ int Config::loader_nz_matrix = 1000;
 // 2: forget cache, all data in memory
 int Config::load_mode = 0;
 
+// exchange snapshot (see exchange/snapshot_writer.h)
+// snapshot_interval: take a snapshot of each stock every N committed orders, 0 to disable
+// snapshot_recover: 1 to restore the exchange from snapshot_folder and ask traders to resend
+int Config::snapshot_interval = 0;
+int Config::snapshot_recover = 0;
+
+// number of matching workers shared by the stocks of an exchange (see exchange/match_scheduler.h)
+// 0: one per stock, bounded by half of the cores
+int Config::match_worker_num = 0;
+
+// how idle loops wait (see common/wait_strategy.hpp): 0 spin, 1 spin-then-yield, 2 spin-then-park
+// (senders and matching workers park on their queues, which producers signal; a recv_mode 0 receiver parks in
+//  a timed sleep of up to 1ms that no message cuts short, use recv_mode 1 to block on the sockets instead)
+// recv: order / trade receivers, send: order / trade senders, match: matching workers
+int Config::recv_wait_strategy = 0;
+int Config::send_wait_strategy = 0;
+int Config::match_wait_strategy = 2;
+
+// how receivers wait for messages (see network/msg_receiver.h): 0 non-blocking recv + recv_wait_strategy, 1 poll (zmq_poll, shm doorbells)
+// the poll timeout bounds how long a console pause waits for an idle receiver, so keep it finite
+int Config::recv_mode = 0;
+int Config::recv_poll_timeout_ms = 10;
+
+// ring bytes of a channel carried by shared memory (see network/shm_ring.hpp), a message takes half of it at most
+int Config::shm_ring_mb = 64;
+
+// 1: every channel is a ZMQ inproc socket pair, only when all nodes share the process (see pipeline_local.cpp)
+int Config::inproc_transport = 0;
+
+// backing of large arrays (see common/huge_page.hpp): 0 off, 1 transparent huge pages, 2 hugetlb pool then transparent
+int Config::huge_pages = 1;
+
+// no pinning by default, the OS places the threads
+std::map<std::string, std::string> Config::thread_pinning;
+
 std::vector<std::vector<std::vector<std::pair<int, int>>>> Config::trader_port2exchange_port;
+std::set<int> Config::shm_ports;
 
 std::vector<std::string> Config::traders_addr;
 std::vector<std::string> Config::exchanges_addr;
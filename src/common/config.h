@@ -4,6 +4,7 @@
 #include <fstream>
 #include <sstream>
 #include <map>
+#include <set>
 #include <string>
 #include <stdio.h>
 #include <stdlib.h>
@@ -21,11 +22,14 @@ public:
     // another choice
     // e.g., static int &num_threads() { static int _num_threads = 2; return _num_threads; }
 
+    // per node (see NodeConfig): a thread reads the ones of the node it works for
+    static thread_local int partition_idx;
+    static thread_local std::string trade_output_folder;
+    static thread_local std::string snapshot_folder;
+
     static std::string data_folder __attribute__((weak));
-    static std::string trade_output_folder __attribute__((weak));
     static std::string network_config_file __attribute__((weak));
 
-    static int partition_idx __attribute__((weak));
     static int sliding_window_size __attribute__((weak));
     static int stock_num __attribute__((weak));
     static int trader_num __attribute__((weak));
@@ -36,9 +40,57 @@ public:
 
     static int load_mode __attribute__((weak));
 
+    static int snapshot_interval __attribute__((weak));
+    static int snapshot_recover __attribute__((weak));
+
+    static int match_worker_num __attribute__((weak));
+
+    static int recv_wait_strategy __attribute__((weak));
+    static int send_wait_strategy __attribute__((weak));
+    static int match_wait_strategy __attribute__((weak));
+
+    static int huge_pages __attribute__((weak));
+
+    static int recv_mode __attribute__((weak));
+    static int recv_poll_timeout_ms __attribute__((weak));
+
+    static int shm_ring_mb __attribute__((weak));
+
+    // all channels over ZMQ inproc, set by pipeline_local which runs every node in one process
+    static int inproc_transport __attribute__((weak));
+
+    // thread role -> core list, e.g. "match_worker" -> "2-5" (config: pin_<role> <cpulist>, see common/topology.hpp)
+    static std::map<std::string, std::string> thread_pinning;
+
     static std::vector<std::string> traders_addr;
     static std::vector<std::string> exchanges_addr;
     static std::vector<std::vector<std::vector<std::pair<int, int>>>> trader_port2exchange_port;
+    // ports of the channels carried by shared memory instead of TCP (see network/transport.h)
+    static std::set<int> shm_ports;
+};
+
+// partition_idx of a trader or an exchange is 0 or 1
+constexpr int MAX_PARTITIONS = 2;
+
+/**
+ * The config items of one node (the trader and the exchange of a partition), the rest are shared.
+ * A process runs one node, except pipeline_local which runs all of them and switches between them;
+ * a ubi_thread starts with the node of the thread that started it.
+ */
+struct NodeConfig {
+    int partition_idx = -1;
+    std::string trade_output_folder;
+    std::string snapshot_folder;
+
+    static NodeConfig current() {
+        return {Config::partition_idx, Config::trade_output_folder, Config::snapshot_folder};
+    }
+
+    void install() const {
+        Config::partition_idx = partition_idx;
+        Config::trade_output_folder = trade_output_folder;
+        Config::snapshot_folder = snapshot_folder;
+    }
 };
 
 static bool set_immutable_config(std::string cfg_name, std::string value)
@@ -77,6 +129,34 @@ static bool set_immutable_config(std::string cfg_name, std::string value)
                                  << "You should set \"network_config_file\" in config file." << LOG_endl;
             exit(-1);
         }
+    } else if (cfg_name == "snapshot_folder") {
+        Config::snapshot_folder = value;
+
+        // force a "/" at the end of Config::snapshot_folder.
+        if (!Config::snapshot_folder.empty() && Config::snapshot_folder[Config::snapshot_folder.length() - 1] != '/')
+            Config::snapshot_folder = Config::snapshot_folder + "/";
+    } else if (cfg_name == "snapshot_interval") {
+        Config::snapshot_interval = atoi(value.c_str());
+    } else if (cfg_name == "snapshot_recover") {
+        Config::snapshot_recover = atoi(value.c_str());
+    } else if (cfg_name == "match_worker_num") {
+        Config::match_worker_num = atoi(value.c_str());
+    } else if (cfg_name == "recv_wait_strategy") {
+        Config::recv_wait_strategy = atoi(value.c_str());
+    } else if (cfg_name == "send_wait_strategy") {
+        Config::send_wait_strategy = atoi(value.c_str());
+    } else if (cfg_name == "match_wait_strategy") {
+        Config::match_wait_strategy = atoi(value.c_str());
+    } else if (cfg_name == "recv_mode") {
+        Config::recv_mode = atoi(value.c_str());
+    } else if (cfg_name == "recv_poll_timeout_ms") {
+        Config::recv_poll_timeout_ms = atoi(value.c_str());
+    } else if (cfg_name == "shm_ring_mb") {
+        Config::shm_ring_mb = atoi(value.c_str());
+    } else if (cfg_name == "huge_pages") {
+        Config::huge_pages = atoi(value.c_str());
+    } else if (boost::starts_with(cfg_name, "pin_")) {
+        Config::thread_pinning[cfg_name.substr(4)] = value;
     } else if (cfg_name == "sliding_window_size") {
         Config::sliding_window_size = atoi(value.c_str());
     } else if (cfg_name == "stock_num") {
@@ -157,6 +237,24 @@ static void reload_config(std::string str)
 /**
  * load network config
  */
+/**
+ * a channel of a trader:exchange link: "<trader_port> <exchange_port> [tcp|shm]",
+ * shm carries the channel through a shared-memory ring, for a trader and an exchange on the same host
+ */
+static void load_port_pair(std::istringstream& iss, std::vector<std::pair<int, int>>& channels)
+{
+    int trader_port, exchange_port;
+    std::string transport = "tcp";
+    iss >> trader_port >> exchange_port >> transport;
+    channels.push_back({trader_port, exchange_port});
+    if (transport == "shm") {
+        Config::shm_ports.insert(trader_port);
+        Config::shm_ports.insert(exchange_port);
+    } else if (transport != "tcp") {
+        logstream(LOG_ERROR) << "Unsupport transport:" << transport << LOG_endl;
+    }
+}
+
 static void load_network_config(std::string fname)
 {
     // load network config file
@@ -170,6 +268,7 @@ static void load_network_config(std::string fname)
     Config::traders_addr.clear();
     Config::exchanges_addr.clear();
     Config::trader_port2exchange_port.clear();
+    Config::shm_ports.clear();
 
     // load new config
     Config::traders_addr.resize(2);
@@ -192,21 +291,13 @@ static void load_network_config(std::string fname)
         } else if(row == "exchange1") {
             iss >> Config::exchanges_addr[1];
         } else if(row == "trader0:exchange0") {
-            int trader_port, exchange_port;
-            iss >> trader_port >> exchange_port;
-            Config::trader_port2exchange_port[0][0].push_back({trader_port, exchange_port});
+            load_port_pair(iss, Config::trader_port2exchange_port[0][0]);
         } else if(row == "trader0:exchange1") {
-            int trader_port, exchange_port;
-            iss >> trader_port >> exchange_port;
-            Config::trader_port2exchange_port[0][1].push_back({trader_port, exchange_port});
+            load_port_pair(iss, Config::trader_port2exchange_port[0][1]);
         } else if(row == "trader1:exchange0") {
-            int trader_port, exchange_port;
-            iss >> trader_port >> exchange_port;
-            Config::trader_port2exchange_port[1][0].push_back({trader_port, exchange_port});
+            load_port_pair(iss, Config::trader_port2exchange_port[1][0]);
         } else if(row == "trader1:exchange1") {
-            int trader_port, exchange_port;
-            iss >> trader_port >> exchange_port;
-            Config::trader_port2exchange_port[1][1].push_back({trader_port, exchange_port});
+            load_port_pair(iss, Config::trader_port2exchange_port[1][1]);
         } else {
             logstream(LOG_ERROR) << "Unsupport item:" << row << LOG_endl;
         }
@@ -216,6 +307,24 @@ static void load_network_config(std::string fname)
     return;
 }
 
+/**
+ * channel layout of a trader:exchange link: the network config lists its channels (port pairs) in order,
+ * channel TRADE_CHANNEL carries trades and ACK_CHANNEL order acks (exchange -> trader),
+ * all the others carry orders (trader -> exchange)
+ */
+constexpr int TRADE_CHANNEL = 2;
+constexpr int ACK_CHANNEL = 3;
+
+static std::vector<int> order_channels(int trader, int exchange)
+{
+    std::vector<int> channels;
+    for (int i = 0; i < (int)Config::trader_port2exchange_port[trader][exchange].size(); i++) {
+        if (i != TRADE_CHANNEL && i != ACK_CHANNEL)
+            channels.push_back(i);
+    }
+    return channels;
+}
+
 /**
  * load config
  */
@@ -257,6 +366,20 @@ static void print_config(void)
     std::cout << "loader_ny_matrix: "         << Config::loader_ny_matrix  << LOG_endl;
     std::cout << "loader_nz_matrix: "         << Config::loader_nz_matrix  << LOG_endl;
     std::cout << "load_mode: "      << Config::load_mode << LOG_endl;
+    std::cout << "snapshot_folder: "      << Config::snapshot_folder << LOG_endl;
+    std::cout << "snapshot_interval: "    << Config::snapshot_interval << LOG_endl;
+    std::cout << "snapshot_recover: "     << Config::snapshot_recover << LOG_endl;
+    std::cout << "match_worker_num: "     << Config::match_worker_num << LOG_endl;
+    std::cout << "recv_wait_strategy: "   << Config::recv_wait_strategy << LOG_endl;
+    std::cout << "send_wait_strategy: "   << Config::send_wait_strategy << LOG_endl;
+    std::cout << "match_wait_strategy: "  << Config::match_wait_strategy << LOG_endl;
+    std::cout << "huge_pages: "           << Config::huge_pages << LOG_endl;
+    std::cout << "recv_mode: "            << Config::recv_mode << LOG_endl;
+    std::cout << "recv_poll_timeout_ms: " << Config::recv_poll_timeout_ms << LOG_endl;
+    std::cout << "shm_ring_mb: "          << Config::shm_ring_mb << LOG_endl;
+    for (auto& [role, cpus] : Config::thread_pinning) {
+        std::cout << "pin_" << role << ": "  << cpus << LOG_endl;
+    }
 
     // print network config
     std::cout << "trader0_addr: "         << Config::traders_addr[0]  << LOG_endl;
@@ -265,19 +388,23 @@ static void print_config(void)
     std::cout << "exchange1_addr: "       << Config::exchanges_addr[1]  << LOG_endl;
     std::cout << "trader0->exchange0 port mapping: " << LOG_endl;
     for(auto& [trader_port, exchange_port] : Config::trader_port2exchange_port[0][0]) {
-        std::cout << trader_port << "->" << exchange_port << LOG_endl;
+        std::cout << trader_port << "->" << exchange_port
+                  << (Config::shm_ports.count(exchange_port) ? " (shm)" : "") << LOG_endl;
     }
     std::cout << "trader0->exchange1 port mapping: " << LOG_endl;
     for(auto& [trader_port, exchange_port] : Config::trader_port2exchange_port[0][1]) {
-        std::cout << trader_port << "->" << exchange_port << LOG_endl;
+        std::cout << trader_port << "->" << exchange_port
+                  << (Config::shm_ports.count(exchange_port) ? " (shm)" : "") << LOG_endl;
     }
     std::cout << "trader1->exchange0 port mapping: " << LOG_endl;
     for(auto& [trader_port, exchange_port] : Config::trader_port2exchange_port[1][0]) {
-        std::cout << trader_port << "->" << exchange_port << LOG_endl;
+        std::cout << trader_port << "->" << exchange_port
+                  << (Config::shm_ports.count(exchange_port) ? " (shm)" : "") << LOG_endl;
     }
     std::cout << "trader1->exchange1 port mapping: " << LOG_endl;
     for(auto& [trader_port, exchange_port] : Config::trader_port2exchange_port[1][1]) {
-        std::cout << trader_port << "->" << exchange_port << LOG_endl;
+        std::cout << trader_port << "->" << exchange_port
+                  << (Config::shm_ports.count(exchange_port) ? " (shm)" : "") << LOG_endl;
     }
     std::cout << "----------- END ------------" << LOG_endl;
 }
@@ -3,6 +3,7 @@
 #include <map>
 #include <memory>
 
+#include "common/config.h"
 #include "utils/assertion.hpp"
 
 namespace ubiquant {
@@ -30,9 +31,10 @@ public:
     }
 
 private:
+    // one instance per node, the node of the calling thread (see NodeConfig), or none (partition_idx -1)
     static T** GetPPtr() {
-        static T* ptr = nullptr;
-        return &ptr;
+        static T* ptrs[MAX_PARTITIONS + 1] = {};
+        return &ptrs[Config::partition_idx + 1];
     }
 };
 
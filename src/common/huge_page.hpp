@@ -0,0 +1,191 @@
+#pragma once
+
+#include <sys/mman.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "common/config.h"
+
+namespace ubiquant {
+
+// how large arrays are backed (config: huge_pages)
+enum HUGE_PAGE_MODE {
+    HUGE_PAGE_OFF = 0,          // plain operator new
+    HUGE_PAGE_TRANSPARENT = 1,  // 2 MB aligned mmap + madvise(MADV_HUGEPAGE)
+    HUGE_PAGE_EXPLICIT = 2,     // mmap(MAP_HUGETLB) from the reserved pool, transparent when the pool is empty
+};
+
+/**
+ * Huge-page backed allocation of large, randomly accessed arrays
+ * (order matrices, order windows, declaration books).
+ *
+ * Only allocations of at least one huge page go through mmap, smaller ones use operator new,
+ * so the rounding never wastes more than half of an allocation. Every mmap'ed region is
+ * recorded, report() tells how much of it is actually backed by huge pages.
+ */
+class HugePages {
+public:
+    constexpr static size_t HUGE_PAGE_SIZE = 2ul << 20;
+
+    static HugePages& get() {
+        static HugePages huge_pages;
+        return huge_pages;
+    }
+
+    void* alloc(size_t bytes) {
+        if (Config::huge_pages == HUGE_PAGE_OFF || bytes < HUGE_PAGE_SIZE)
+            return ::operator new(bytes);
+
+        size_t len = round_up(bytes);
+        if (Config::huge_pages == HUGE_PAGE_EXPLICIT) {
+            void* addr = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (addr != MAP_FAILED) {
+                record(addr, len, true);
+                return addr;
+            }
+        }
+
+        // over-map by one huge page and trim, so that the region is 2 MB aligned for THP
+        void* raw = mmap(nullptr, len + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+            throw std::bad_alloc();
+        uintptr_t begin = (uintptr_t)raw;
+        uintptr_t aligned = (begin + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        if (aligned != begin)
+            munmap(raw, aligned - begin);
+        if (begin + HUGE_PAGE_SIZE != aligned)
+            munmap((void*)(aligned + len), begin + HUGE_PAGE_SIZE - aligned);
+        madvise((void*)aligned, len, MADV_HUGEPAGE);
+        record((void*)aligned, len, false);
+        return (void*)aligned;
+    }
+
+    void free(void* addr) {
+        if (addr == nullptr)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            auto it = regions_.find((uintptr_t)addr);
+            if (it != regions_.end()) {
+                munmap(addr, it->second.len);
+                regions_.erase(it);
+                return;
+            }
+        }
+        ::operator delete(addr);
+    }
+
+    // log the mmap'ed regions and how much of them the kernel backs with huge pages
+    void report(const std::string& who) {
+        size_t total = 0, hugetlb = 0, transparent = 0;
+        std::map<uintptr_t, Region> regions;
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            regions = regions_;
+        }
+        for (auto& [addr, region] : regions) {
+            total += region.len;
+            if (region.hugetlb)
+                hugetlb += region.len;
+        }
+        transparent = transparent_bytes(regions);
+        logstream(LOG_EMPH) << who << " huge pages: " << regions.size() << " regions, " << (total >> 20) << " MB mapped, "
+                            << (hugetlb >> 20) << " MB hugetlb, " << (transparent >> 20) << " MB transparent, "
+                            << ((total - hugetlb - transparent) >> 20) << " MB on 4 KB pages" << LOG_endl;
+    }
+
+private:
+    struct Region {
+        size_t len;
+        bool hugetlb;
+    };
+
+    static size_t round_up(size_t bytes) { return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1); }
+
+    void record(void* addr, size_t len, bool hugetlb) {
+        std::lock_guard<std::mutex> lock(m_);
+        regions_[(uintptr_t)addr] = {len, hugetlb};
+    }
+
+    // sum AnonHugePages of the mappings (in /proc/self/smaps) that overlap our transparent regions
+    static size_t transparent_bytes(const std::map<uintptr_t, Region>& regions) {
+        std::ifstream smaps("/proc/self/smaps");
+        std::string line;
+        bool ours = false;
+        size_t bytes = 0;
+        while (std::getline(smaps, line)) {
+            std::istringstream iss(line);
+            std::string first;
+            if (!(iss >> first))
+                continue;
+            // a mapping header "start-end perms ...", followed by its "Field: value kB" lines
+            size_t dash = first.find('-');
+            if (dash != std::string::npos && first.back() != ':') {
+                uintptr_t start = std::stoul(first.substr(0, dash), nullptr, 16);
+                uintptr_t end = std::stoul(first.substr(dash + 1), nullptr, 16);
+                auto it = regions.upper_bound(start);
+                ours = (it != regions.end() && !it->second.hugetlb && it->first < end);
+                if (it != regions.begin()) {
+                    auto prev = std::prev(it);
+                    ours |= !prev->second.hugetlb && prev->first + prev->second.len > start;
+                }
+                continue;
+            }
+            if (ours && first == "AnonHugePages:") {
+                size_t kb = 0;
+                iss >> kb;
+                bytes += kb << 10;
+            }
+        }
+        return bytes;
+    }
+
+    std::mutex m_;
+    std::map<uintptr_t, Region> regions_;
+};
+
+inline void* huge_alloc(size_t bytes) { return HugePages::get().alloc(bytes); }
+inline void huge_free(void* addr) { HugePages::get().free(addr); }
+
+// zero-filled array of trivial elements, drop-in for std::shared_ptr<T[]>(new T[n])
+template <class T>
+std::shared_ptr<T[]> make_huge_array(size_t n) {
+    static_assert(std::is_trivial<T>::value, "huge arrays hold trivial elements only");
+    T* data = (T*)huge_alloc(sizeof(T) * n);
+    memset((void*)data, 0, sizeof(T) * n);
+    return std::shared_ptr<T[]>(data, [](T* p) { huge_free(p); });
+}
+
+// std allocator on top of huge_alloc, for containers that may grow large
+template <class T>
+struct HugePageAllocator {
+    using value_type = T;
+
+    HugePageAllocator() = default;
+    template <class U>
+    HugePageAllocator(const HugePageAllocator<U>&) {}
+
+    T* allocate(size_t n) { return (T*)huge_alloc(sizeof(T) * n); }
+    void deallocate(T* p, size_t) { huge_free(p); }
+
+    template <class U>
+    bool operator==(const HugePageAllocator<U>&) const { return true; }
+    template <class U>
+    bool operator!=(const HugePageAllocator<U>&) const { return false; }
+};
+
+template <class T>
+using huge_vector = std::vector<T, HugePageAllocator<T>>;
+
+}  // namespace ubiquant
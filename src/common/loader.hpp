@@ -4,14 +4,18 @@
 #include <array>
 #include <cassert>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <unordered_map>
 #include <vector>
 
 #include "H5Cpp.h"
 #include "common/config.h"
+#include "common/huge_page.hpp"
 #include "common/type.hpp"
 #include "utils/assertion.hpp"
 #include "utils/timer.hpp"
@@ -28,39 +32,48 @@ enum matrix_idx {
 };
 
 // const H5std_string h5_prefix = "/data/100x1000x1000/";
-H5std_string hook_fname;
-
-std::vector<std::vector<H5std_string>> INPUT_FILE_NAME;
-std::vector<std::vector<H5std_string>> CACHE_FILE_NAME;
-
-bool loader_inited = false;
-
-void init_loader() {
-    hook_fname = Config::data_folder + "hook.h5";
-
-    INPUT_FILE_NAME = std::vector<std::vector<H5std_string>>({{Config::data_folder + "order_id1.h5",
-                                                               Config::data_folder + "direction1.h5",
-                                                               Config::data_folder + "type1.h5",
-                                                               Config::data_folder + "price1.h5",
-                                                               Config::data_folder + "volume1.h5"},
-                                                              {Config::data_folder + "order_id2.h5",
-                                                               Config::data_folder + "direction2.h5",
-                                                               Config::data_folder + "type2.h5",
-                                                               Config::data_folder + "price2.h5",
-                                                               Config::data_folder + "volume2.h5"}});
-
-    CACHE_FILE_NAME = std::vector<std::vector<H5std_string>>({{Config::trade_output_folder + "order_id1.mat",
-                                                               Config::trade_output_folder + "direction1.mat",
-                                                               Config::trade_output_folder + "type1.mat",
-                                                               Config::trade_output_folder + "price1.mat",
-                                                               Config::trade_output_folder + "volume1.mat"},
-                                                              {Config::trade_output_folder + "order_id2.mat",
-                                                               Config::trade_output_folder + "direction2.mat",
-                                                               Config::trade_output_folder + "type2.mat",
-                                                               Config::trade_output_folder + "price2.mat",
-                                                               Config::trade_output_folder + "volume2.mat"}});
-
-    loader_inited = true;
+// NOTICE: globals and functions are inline, so the loader can be included by several translation units
+inline H5std_string hook_fname;
+
+inline std::vector<std::vector<H5std_string>> INPUT_FILE_NAME;
+inline std::vector<std::vector<H5std_string>> CACHE_FILE_NAME;
+
+inline bool loader_inited = false;
+inline std::mutex loader_lock;
+
+// sorted order caches of partition part, kept in the output folder of its trader
+inline std::vector<H5std_string> cache_fnames(const std::string& folder, int part) {
+    std::string suffix = std::to_string(part + 1) + ".mat";
+    return {folder + "order_id" + suffix,
+            folder + "direction" + suffix,
+            folder + "type" + suffix,
+            folder + "price" + suffix,
+            folder + "volume" + suffix};
+}
+
+// every node of the process calls it, the caches of its own partition go to its own output folder
+inline void init_loader() {
+    std::lock_guard<std::mutex> lock(loader_lock);
+    if (!loader_inited) {
+        hook_fname = Config::data_folder + "hook.h5";
+
+        INPUT_FILE_NAME = std::vector<std::vector<H5std_string>>({{Config::data_folder + "order_id1.h5",
+                                                                   Config::data_folder + "direction1.h5",
+                                                                   Config::data_folder + "type1.h5",
+                                                                   Config::data_folder + "price1.h5",
+                                                                   Config::data_folder + "volume1.h5"},
+                                                                  {Config::data_folder + "order_id2.h5",
+                                                                   Config::data_folder + "direction2.h5",
+                                                                   Config::data_folder + "type2.h5",
+                                                                   Config::data_folder + "price2.h5",
+                                                                   Config::data_folder + "volume2.h5"}});
+
+        CACHE_FILE_NAME = {cache_fnames(Config::trade_output_folder, 0), cache_fnames(Config::trade_output_folder, 1)};
+
+        loader_inited = true;
+    } else if (Config::partition_idx >= 0) {
+        CACHE_FILE_NAME[Config::partition_idx] = cache_fnames(Config::trade_output_folder, Config::partition_idx);
+    }
 }
 
 // part should be 0 or 1
@@ -72,6 +85,39 @@ inline H5std_string get_cache_fname(int part, matrix_idx idx) {
     return CACHE_FILE_NAME[part][idx];
 }
 
+// read the whole sorted cache (load_mode 0) of one stock written by trader `part`
+inline std::vector<Order> load_cached_orders(int part, int stk_code_minus_one) {
+    const uint64_t num_order = (uint64_t)Config::loader_nx_matrix * Config::loader_ny_matrix * Config::loader_nz_matrix / Config::stock_num;
+    std::vector<order_id_t> order_ids(num_order);
+    std::vector<direction_t> directions(num_order);
+    std::vector<type_t> types(num_order);
+    std::vector<price_t> prices(num_order);
+    std::vector<volume_t> volumes(num_order);
+
+    auto read_cache = [&](matrix_idx idx, char* buf, size_t len) {
+        std::ifstream ifs(get_cache_fname(part, idx) + "-" + std::to_string(stk_code_minus_one), std::ios::in | std::ios::binary);
+        if (!ifs.read(buf, len))
+            throw std::runtime_error("Cannot read cache file " + get_cache_fname(part, idx) + "-" + std::to_string(stk_code_minus_one));
+    };
+    read_cache(order_id_idx, (char*)order_ids.data(), sizeof(order_id_t) * num_order);
+    read_cache(direction_idx, (char*)directions.data(), sizeof(direction_t) * num_order);
+    read_cache(type_idx, (char*)types.data(), sizeof(type_t) * num_order);
+    read_cache(price_idx, (char*)prices.data(), sizeof(price_t) * num_order);
+    read_cache(volume_idx, (char*)volumes.data(), sizeof(volume_t) * num_order);
+
+    std::vector<Order> orders(num_order);
+    for (uint64_t i = 0; i < num_order; i++) {
+        Order& order = orders[i];
+        order.stk_code = stk_code_minus_one + 1;
+        order.order_id = order_ids[i];
+        order.direction = directions[i];
+        order.type = types[i];
+        order.price = prices[i];
+        order.volume = volumes[i];
+    }
+    return orders;
+}
+
 const std::vector<H5std_string> DATASET_NAME = {
     "order_id",
     "direction",
@@ -84,16 +130,27 @@ const H5std_string PREV_CLOSE_DATASET = "prev_close";
 // (10, 100, 4)
 const H5std_string HOOK_DATASET = "hook";
 
-void dataset_read(int* data_read, const H5::DataSet& dataset, const H5::DataSpace& memspace, const H5::DataSpace& dataspace) {
+inline void dataset_read(int* data_read, const H5::DataSet& dataset, const H5::DataSpace& memspace, const H5::DataSpace& dataspace) {
     dataset.read(data_read, H5::PredType::NATIVE_INT, memspace, dataspace);
 }
 
-void dataset_read(double* data_read, const H5::DataSet& dataset, const H5::DataSpace& memspace, const H5::DataSpace& dataspace) {
+inline void dataset_read(double* data_read, const H5::DataSet& dataset, const H5::DataSpace& memspace, const H5::DataSpace& dataspace) {
     dataset.read(data_read, H5::PredType::NATIVE_DOUBLE, memspace, dataspace);
 }
 
+// prices are stored as double in the input files, convert them to ticks once here
+inline void dataset_read(price_t* data_read, const H5::DataSet& dataset, const H5::DataSpace& memspace, const H5::DataSpace& dataspace) {
+    hssize_t num_data = memspace.getSimpleExtentNpoints();
+    std::unique_ptr<double[]> raw(new double[num_data]);
+    dataset.read(raw.get(), H5::PredType::NATIVE_DOUBLE, memspace, dataspace);
+    for (hssize_t i = 0; i < num_data; i++) {
+        data_read[i] = price_from_double(raw[i]);
+    }
+}
+
 // load_matrix_from_file<int> -> shared_ptr<int[]>
 // load_matrix_from_file<double> -> shared_ptr<double[]>
+// load_matrix_from_file<price_t> -> shared_ptr<price_t[]> (in ticks)
 template <typename T>
 std::shared_ptr<T[]> load_matrix_from_file(const H5std_string fname, const H5std_string dataset_name, const int rank, const hsize_t* count, const hsize_t* offset) {
     assert(loader_inited);
@@ -103,8 +160,7 @@ std::shared_ptr<T[]> load_matrix_from_file(const H5std_string fname, const H5std
         num_data *= count[i];
     }
 
-    std::shared_ptr<T[]> data_read(new T[num_data]);
-    memset((void*)data_read.get(), 0, sizeof(T) * num_data);
+    std::shared_ptr<T[]> data_read = make_huge_array<T>(num_data);
     H5::H5File file(fname, H5F_ACC_RDONLY);
     H5::DataSet dataset = file.openDataSet(dataset_name);
 
@@ -139,7 +195,7 @@ std::shared_ptr<T[]> load_matrix_from_file(const H5std_string fname, const H5std
     return data_read;
 }
 
-std::vector<std::vector<SortStruct>> load_order_id_from_file(int part) {
+inline std::vector<std::vector<SortStruct>> load_order_id_from_file(int part) {
     // read a 500x1000x1000 matrix
     const int NX_SUB = Config::loader_nx_matrix;
     const int NY_SUB = Config::loader_ny_matrix;
@@ -182,7 +238,7 @@ std::vector<std::vector<SortStruct>> load_order_id_from_file(int part) {
     return order_id;
 }
 
-std::pair<std::vector<std::unordered_map<order_id_t, HookTarget>>, std::shared_ptr<std::vector<std::unordered_map<trade_idx_t, volume_t>>>> load_hook() {
+inline std::pair<std::vector<std::unordered_map<order_id_t, HookTarget>>, std::shared_ptr<std::vector<std::unordered_map<trade_idx_t, volume_t>>>> load_hook() {
     const int NX_SUB = 10;
     const int NY_SUB = 100;
     const int NZ_SUB = 4;
@@ -225,21 +281,23 @@ std::pair<std::vector<std::unordered_map<order_id_t, HookTarget>>, std::shared_p
     return make_pair(hook, hooked_trade);
 }
 
-std::vector<std::vector<price_t>> load_prev_close(int part) {
+inline std::vector<std::vector<price_t>> load_prev_close(int part) {
     hsize_t offset = 0;
     hsize_t count = Config::stock_num;
 
-    auto data_read = load_matrix_from_file<price_t>(get_input_fname(part, price_idx), PREV_CLOSE_DATASET, 1, &count, &offset);
+    auto data_read = load_matrix_from_file<double>(get_input_fname(part, price_idx), PREV_CLOSE_DATASET, 1, &count, &offset);
 
+    // limits are computed in double, then turned into the inclusive tick range
+    // that accepts exactly the same input prices as the double comparison
     std::vector<std::vector<price_t>> price_limits(2, std::vector<price_t>(10));
     for (int t = 0; t < Config::stock_num; t++) {
-        price_limits[0][t] = data_read[t] - data_read[t] * 0.1;  // ALERT: *0.9 != 1 - 0.1
-        price_limits[1][t] = data_read[t] + data_read[t] * 0.1;
+        price_limits[0][t] = price_lower_bound(data_read[t] - data_read[t] * 0.1);  // ALERT: *0.9 != 1 - 0.1
+        price_limits[1][t] = price_upper_bound(data_read[t] + data_read[t] * 0.1);
     }
 
     std::cout << "prev_price\tmin\tmax" << std::endl;
     for (int t = 0; t < Config::stock_num; t++) {
-        std::cout << data_read[t] << "\t" << price_limits[0][t] << "\t" << price_limits[1][t] << std::endl;
+        std::cout << data_read[t] << "\t" << price_to_double(price_limits[0][t]) << "\t" << price_to_double(price_limits[1][t]) << std::endl;
     }
 
     return price_limits;
@@ -329,6 +387,50 @@ class OrderGenerator {
         start_idx[--stk_code]++;
     }
 
+    // restart the order stream of stk_code from the first order whose id >= order_id
+    // (e.g. when an exchange recovers from a snapshot)
+    // NOTICE: the cache of a stock is sorted by order id, but only holds the orders of this trader
+    void rewind(stock_code_t stk_code, order_id_t order_id) {
+        stk_code--;
+
+        // binary search the order id cache
+        std::ifstream& id_ifs = ifs[stk_code][order_id_idx];
+        int lo = 0, hi = length * num_partition;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            order_id_t mid_id;
+            id_ifs.clear();
+            id_ifs.seekg((uint64_t)mid * sizeof(order_id_t));
+            id_ifs.read((char*)&mid_id, sizeof(order_id_t));
+            if (mid_id < order_id)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        int idx = lo;
+        int partition = idx / length;
+        if (partition >= num_partition) {
+            cur_partition[stk_code] = num_partition;
+            start_idx[stk_code] = length;
+            return;
+        }
+
+        uint64_t first = (uint64_t)partition * length;
+        for (int i = 0; i < num_matrix; i++) {
+            ifs[stk_code][i].clear();
+        }
+        ifs[stk_code][order_id_idx].seekg(first * sizeof(order_id_t));
+        ifs[stk_code][direction_idx].seekg(first * sizeof(direction_t));
+        ifs[stk_code][type_idx].seekg(first * sizeof(type_t));
+        ifs[stk_code][price_idx].seekg(first * sizeof(price_t));
+        ifs[stk_code][volume_idx].seekg(first * sizeof(volume_t));
+
+        cur_partition[stk_code] = partition;
+        load_data(stk_code);
+        start_idx[stk_code] = idx % length;
+    }
+
     OrderGenerator() {
         uint64_t start = timer::get_usec();
         ifs = std::vector<std::vector<std::ifstream>>(Config::stock_num);
@@ -349,11 +451,11 @@ class OrderGenerator {
         volume_matrix.resize(Config::stock_num);
 
         for (int t = 0; t < Config::stock_num; t++) {
-            order_id_matrix[t] = std::shared_ptr<order_id_t[]>(new order_id_t[length]);
-            direction_matrix[t] = std::shared_ptr<direction_t[]>(new direction_t[length]);
-            type_matrix[t] = std::shared_ptr<type_t[]>(new type_t[length]);
-            price_matrix[t] = std::shared_ptr<price_t[]>(new price_t[length]);
-            volume_matrix[t] = std::shared_ptr<volume_t[]>(new volume_t[length]);
+            order_id_matrix[t] = make_huge_array<order_id_t>(length);
+            direction_matrix[t] = make_huge_array<direction_t>(length);
+            type_matrix[t] = make_huge_array<type_t>(length);
+            price_matrix[t] = make_huge_array<price_t>(length);
+            volume_matrix[t] = make_huge_array<volume_t>(length);
             load_data(t);
         }
 
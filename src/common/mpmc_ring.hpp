@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace ubiquant {
+
+/**
+ * Bounded lock-free multi-producer multi-consumer ring, non-blocking on both ends.
+ *
+ * Same slot sequence scheme as MpscRing: slot pos is free for the producer claiming pos when its
+ * sequence is pos, and holds an item for the consumer claiming pos when its sequence is pos + 1.
+ * Both ends claim a position with a CAS on their counter, so a full ring fails try_put() and an
+ * empty one fails try_take() instead of waiting.
+ */
+template <class T>
+class MpmcRing {
+public:
+    explicit MpmcRing(int capacity)
+        : capacity_(round_up(capacity)), mask_(capacity_ - 1), slots_(new Slot[capacity_]) {
+        for (uint64_t i = 0; i < capacity_; i++) {
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    inline uint64_t get_capacity() const { return capacity_; }
+
+    bool try_put(const T& t) {
+        uint64_t pos = tail_.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots_[pos & mask_];
+            int64_t diff = (int64_t)slot->seq.load(std::memory_order_acquire) - (int64_t)pos;
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        slot->data = t;
+        slot->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_take(T& t) {
+        uint64_t pos = head_.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots_[pos & mask_];
+            int64_t diff = (int64_t)slot->seq.load(std::memory_order_acquire) - (int64_t)(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;  // empty
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+        t = slot->data;
+        slot->seq.store(pos + capacity_, std::memory_order_release);
+        return true;
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        T data;
+    };
+
+    static uint64_t round_up(int capacity) {
+        uint64_t cap = 1;
+        while (cap < (uint64_t)capacity) cap <<= 1;
+        return cap;
+    }
+
+    const uint64_t capacity_;
+    const uint64_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    alignas(64) std::atomic<uint64_t> head_{0};
+};
+
+}  // namespace ubiquant
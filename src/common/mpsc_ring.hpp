@@ -0,0 +1,180 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "common/topology.hpp"
+
+namespace ubiquant {
+
+/**
+ * Bounded lock-free multi-producer single-consumer ring.
+ *
+ * A producer claims a position with one fetch_add on tail_, waits for its slot only when the ring
+ * is full (spin, then yield, then park), moves the item in and publishes it by setting the slot
+ * sequence to pos + 1 (release). The consumer drains the contiguous published run in batches and
+ * hands each slot back with sequence pos + capacity. Parking uses a mutex/condition variable,
+ * touched only when a thread is actually parked.
+ */
+template <class T>
+class MpscRing {
+public:
+    explicit MpscRing(int capacity)
+        : capacity_(round_up(capacity)), mask_(capacity_ - 1), slots_(new Slot[capacity_]) {
+        for (uint64_t i = 0; i < capacity_; i++) {
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    inline uint64_t get_capacity() const { return capacity_; }
+
+    // blocking api: blocks only when the ring is full
+    void put(T&& t);
+    void put(const T& t) {
+        T copy(t);
+        put(std::move(copy));
+    }
+
+    // non-blocking api (single consumer): f(T&) on up to max_batch published items in order
+    template <class F>
+    size_t drain(F&& f, size_t max_batch);
+
+    // blocking api (single consumer): wait up to timeout for at least one item (put() wakes the consumer),
+    // then drain; returns 0 on timeout
+    template <class F>
+    size_t take(F&& f, size_t max_batch, std::chrono::microseconds timeout);
+
+    // blocking api (single consumer): wait up to timeout for at least one item without taking it
+    bool wait_for(std::chrono::microseconds timeout) {
+        return wait([this] { return !empty(); }, not_empty_, consumer_parked_,
+                    std::chrono::steady_clock::now() + timeout);
+    }
+
+    // move the slots to the NUMA node of the consumer
+    void bind_memory(int node) const {
+        ubiquant::bind_memory(slots_.get(), sizeof(Slot) * capacity_, node);
+    }
+
+    bool empty() const {
+        return slots_[head_ & mask_].seq.load(std::memory_order_acquire) != head_ + 1;
+    }
+
+private:
+    constexpr static int SPIN_ROUNDS = 128;
+    constexpr static int YIELD_ROUNDS = 16;
+    constexpr static auto PARK_TIMEOUT = std::chrono::microseconds(200);
+
+    struct Slot {
+        std::atomic<uint64_t> seq;
+        T data;
+    };
+
+    static uint64_t round_up(int capacity) {
+        uint64_t cap = 1;
+        while (cap < (uint64_t)capacity) cap <<= 1;
+        return cap;
+    }
+
+    // spin, then yield, then park on cv until ready() holds, or until deadline; returns ready()
+    template <class Ready>
+    bool wait(Ready ready, std::condition_variable& cv, std::atomic<int>& parked,
+              std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+    void wake(std::condition_variable& cv, std::atomic<int>& parked) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_relaxed) == 0)
+            return;
+        { std::lock_guard<std::mutex> lock(park_mutex_); }
+        cv.notify_all();
+    }
+
+    const uint64_t capacity_;
+    const uint64_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    // written by the consumer only
+    alignas(64) uint64_t head_ = 0;
+
+    alignas(64) std::mutex park_mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    std::atomic<int> producers_parked_{0};
+    std::atomic<int> consumer_parked_{0};
+};
+
+template <class T>
+template <class Ready>
+bool MpscRing<T>::wait(Ready ready, std::condition_variable& cv, std::atomic<int>& parked,
+                       std::chrono::steady_clock::time_point deadline) {
+    for (int i = 0; i < SPIN_ROUNDS; i++) {
+        if (ready()) return true;
+    }
+    for (int i = 0; i < YIELD_ROUNDS; i++) {
+        if (ready()) return true;
+        std::this_thread::yield();
+    }
+    while (!ready()) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            return false;
+        parked.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        {
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            cv.wait_until(lock, std::min(deadline, now + PARK_TIMEOUT), ready);
+        }
+        parked.fetch_sub(1);
+    }
+    return true;
+}
+
+template <class T>
+void MpscRing<T>::put(T&& t) {
+    uint64_t pos = tail_.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots_[pos & mask_];
+    auto free = [&] { return slot.seq.load(std::memory_order_acquire) == pos; };
+    if (!free())
+        wait(free, not_full_, producers_parked_);
+
+    slot.data = std::move(t);
+    slot.seq.store(pos + 1, std::memory_order_release);
+    wake(not_empty_, consumer_parked_);
+}
+
+template <class T>
+template <class F>
+size_t MpscRing<T>::drain(F&& f, size_t max_batch) {
+    size_t cnt = 0;
+    for (; cnt < max_batch; cnt++) {
+        Slot& slot = slots_[head_ & mask_];
+        if (slot.seq.load(std::memory_order_acquire) != head_ + 1)
+            break;
+        T item = std::move(slot.data);
+        slot.seq.store(head_ + capacity_, std::memory_order_release);
+        head_++;
+        f(item);
+    }
+    if (cnt != 0)
+        wake(not_full_, producers_parked_);
+    return cnt;
+}
+
+template <class T>
+template <class F>
+size_t MpscRing<T>::take(F&& f, size_t max_batch, std::chrono::microseconds timeout) {
+    if (!wait_for(timeout))
+        return 0;
+    return drain(std::forward<F>(f), max_batch);
+}
+
+}  // namespace ubiquant
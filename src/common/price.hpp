@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace ubiquant {
+
+/**
+ * Fixed-point price representation.
+ *
+ * All prices inside trader/exchange are int64 ticks of 0.01. They are
+ * converted once when loaded from the input files, and converted back to
+ * the legacy double only when a Trade is written to trade_res.*.
+ */
+using price_t = int64_t;
+
+constexpr price_t PRICE_SCALE = 100;
+
+// input prices have at most two decimals, so rounding recovers the exact tick
+inline price_t price_from_double(double price) {
+    return (price_t)std::llround(price * PRICE_SCALE);
+}
+
+// k / 100.0 is the same double the input file stores for a two-decimal price
+inline double price_to_double(price_t price) {
+    return (double)price / PRICE_SCALE;
+}
+
+// smallest tick whose legacy double is >= limit
+inline price_t price_lower_bound(double limit) {
+    price_t tick = price_from_double(limit);
+    while (price_to_double(tick) < limit) tick++;
+    while (price_to_double(tick - 1) >= limit) tick--;
+    return tick;
+}
+
+// largest tick whose legacy double is <= limit
+inline price_t price_upper_bound(double limit) {
+    price_t tick = price_from_double(limit);
+    while (price_to_double(tick) > limit) tick--;
+    while (price_to_double(tick + 1) <= limit) tick++;
+    return tick;
+}
+
+}  // namespace ubiquant
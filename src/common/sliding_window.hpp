@@ -1,99 +1,191 @@
 #pragma once
 #include <iostream>
-#include <mutex>
-#include <condition_variable>
-#include <deque>
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <chrono>
+#include <cstdint>
 #include <thread>
 
+#include "common/huge_page.hpp"
+#include "common/topology.hpp"
+#include "utils/assertion.hpp"
+
 namespace ubiquant {
 
+/**
+ * Lock-free sequenced window (multi-producer, single consumer).
+ *
+ * The capacity is rounded up to a power of two, so the slot of an absolute position
+ * (seq, e.g. order_id - 1) is seq & mask. Each slot carries the sequence it holds:
+ * seq + 1 once the item is published (release by the producer, acquire by the consumer),
+ * (seq + 1) | CLAIMED while a producer is writing it. The consumer owns base_, the absolute
+ * position of head; a slot is free for seq as soon as base_ has passed seq - capacity.
+ */
 template<class T>
 class SlidingWindow {
 public:
     using size_type = typename std::vector<T>::size_type;
 
 public:
-    SlidingWindow() : capacity_(0) {}
-    SlidingWindow(const int capacity)  
-        : data_(capacity), avaliable_(capacity, false), capacity_(capacity) {}
+    SlidingWindow() : capacity_(0), mask_(0) {}
+    SlidingWindow(const int capacity)
+        : capacity_(round_up(capacity)), mask_(capacity_ - 1), slots_(capacity_) {}
     ~SlidingWindow(){}
 
     SlidingWindow(const SlidingWindow &) = delete;
     SlidingWindow &operator = (const SlidingWindow &) = delete;
-    SlidingWindow(SlidingWindow &&) = default;
-    SlidingWindow &operator = (SlidingWindow &&) = default;
 
     inline int get_capacity() { return capacity_; }
 
 public:
     // blocking api
+    // idx is the absolute position; wait until the window slides over it
     void put(const T t, size_t idx);
     T get();
 
     // non-blocking api
-    // NOTICE: we have no offer function because every put operation will be success
     bool poll(T& t);
     bool poll(T& t, std::chrono::milliseconds& time);
 
+    // sequence api: seq is the absolute position (order_id - 1)
+    // returns false for a seq outside [base, base + capacity) or a slot already filled,
+    // so duplicated or stale items (e.g. resent after an exchange restart) are dropped
+    bool offer(const T& t, uint64_t seq);
+    // drop everything and restart the window at absolute position base (no concurrent producer)
+    void reset(uint64_t base);
+    // whether the item at head is avaliable, i.e. drain() would make progress
+    bool ready() const;
+
+    // zero-copy api (single consumer)
+    // walk the contiguous ready run from head in place, then release all of it
+    template <class F>
+    size_t drain(F&& f);
+
+    // move the slots to the NUMA node of the consumer (before it starts)
+    void bind_memory(int node) const {
+        ubiquant::bind_memory(slots_, node);
+    }
+
 private:
-    std::vector<T> data_;
-    std::vector<bool> avaliable_;
+    constexpr static uint64_t CLAIMED = 1ull << 63;
+
+    struct Slot {
+        std::atomic<uint64_t> seq{0};
+        T data;
+    };
+
+    static int round_up(int capacity) {
+        int cap = 1;
+        while (cap < capacity) cap <<= 1;
+        return cap;
+    }
+
     const int capacity_;
+    const uint64_t mask_;
+    // randomly indexed by the producers, backed by huge pages once large enough
+    huge_vector<Slot> slots_;
 
-    size_t head_ = 0;
-    mutable std::mutex m_mutex;
-    std::condition_variable m_cond_avail;
+    // absolute position of head, written by the consumer only
+    alignas(64) std::atomic<uint64_t> base_{0};
 };
 
 template <class T>
-void SlidingWindow<T>::put(const T t, size_t idx){
-    std::unique_lock<std::mutex> lock(m_mutex);
-    ASSERT(!avaliable_[idx]);
-    data_[idx] = t;
-    avaliable_[idx] = true;
-    if(idx == head_) {
-        m_cond_avail.notify_all();
+bool SlidingWindow<T>::offer(const T& t, uint64_t seq){
+    uint64_t base = base_.load(std::memory_order_acquire);
+    if(seq < base || seq >= base + capacity_){
+        return false;
     }
+
+    // claim the slot, the item of seq - capacity in it has already been consumed
+    Slot& slot = slots_[seq & mask_];
+    uint64_t cur = slot.seq.load(std::memory_order_relaxed);
+    do {
+        if((cur & ~CLAIMED) == seq + 1){
+            return false;
+        }
+    } while(!slot.seq.compare_exchange_weak(cur, (seq + 1) | CLAIMED, std::memory_order_acquire, std::memory_order_relaxed));
+
+    slot.data = t;
+    slot.seq.store(seq + 1, std::memory_order_release);
+    return true;
 }
 
 template <class T>
-T SlidingWindow<T>::get(){
-    std::unique_lock<std::mutex> lock(m_mutex);
-    // get必须判断head位置avaliable
-    m_cond_avail.wait(lock, [&](){return avaliable_[head_];});
-    auto res = data_[head_];
-    avaliable_[head_] = false;
-    head_ = (head_ + 1) % capacity_;
-    return res;
+void SlidingWindow<T>::put(const T t, size_t idx){
+    while(idx >= base_.load(std::memory_order_acquire) + capacity_){
+        std::this_thread::yield();
+    }
+    bool ok = offer(t, idx);
+    ASSERT(ok);
 }
 
 template <class T>
 bool SlidingWindow<T>::poll(T& t){
-    std::lock_guard<std::mutex> lock(m_mutex);
-    if(!avaliable_[head_]){
+    uint64_t base = base_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[base & mask_];
+    if(slot.seq.load(std::memory_order_acquire) != base + 1){
         return false;
     }
-    t = data_[head_];
-    avaliable_[head_] = false;
-    head_ = (head_ + 1) % capacity_;
+    t = slot.data;
+    base_.store(base + 1, std::memory_order_release);
     return true;
 }
 
+template <class T>
+T SlidingWindow<T>::get(){
+    T t;
+    while(!poll(t)){
+        std::this_thread::yield();
+    }
+    return t;
+}
+
 template <class T>
 bool SlidingWindow<T>::poll(T& t, std::chrono::milliseconds& time){
-    std::lock_guard<std::mutex> lock(m_mutex);
-    bool result = m_cond_avail.wait_for(lock, time, [&] {return avaliable_[head_];});
-    if(!result){
-        return false;
+    auto deadline = std::chrono::steady_clock::now() + time;
+    while(!poll(t)){
+        if(std::chrono::steady_clock::now() >= deadline){
+            return false;
+        }
+        std::this_thread::yield();
     }
-    t = data_[head_];
-    avaliable_[head_] = false;
-    head_ = (head_ + 1) % capacity_;
     return true;
 }
 
+template <class T>
+template <class F>
+size_t SlidingWindow<T>::drain(F&& f){
+    // slots of the run stay owned by the consumer until base_ moves past them
+    uint64_t base = base_.load(std::memory_order_relaxed);
+    size_t cnt = 0;
+    for (; cnt < (size_t)capacity_; cnt++) {
+        Slot& slot = slots_[(base + cnt) & mask_];
+        if(slot.seq.load(std::memory_order_acquire) != base + cnt + 1){
+            break;
+        }
+        f(slot.data);
+    }
+    if(cnt != 0){
+        base_.store(base + cnt, std::memory_order_release);
+    }
+    return cnt;
+}
+
+template <class T>
+bool SlidingWindow<T>::ready() const{
+    uint64_t base = base_.load(std::memory_order_acquire);
+    return slots_[base & mask_].seq.load(std::memory_order_acquire) == base + 1;
+}
+
+template <class T>
+void SlidingWindow<T>::reset(uint64_t base){
+    for (int i = 0; i < capacity_; i++) {
+        slots_[i].seq.store(0, std::memory_order_relaxed);
+    }
+    base_.store(base, std::memory_order_release);
+}
+
 static void testSlidingWindow(){
     auto produce = [](SlidingWindow<int> &q) {};
     auto consume = [](SlidingWindow<int> &q) {};
@@ -106,4 +198,4 @@ static void testSlidingWindow(){
     t3.join();
 }
 
-}
\ No newline at end of file
+}
@@ -36,6 +36,7 @@ ubi_thread::~ubi_thread()
 void
 ubi_thread::start()
 {
+  node = ubiquant::NodeConfig::current();
   pthread_attr_t attr;
   ALWAYS_ASSERT(pthread_attr_init(&attr) == 0);
   if (daemon)
@@ -86,6 +87,7 @@ void *
 ubi_thread::pthread_bootstrap(void *p)
 {
   ubi_thread *self = static_cast<ubi_thread *>(p);
+  self->node.install();
   try {
     self->run();
   } catch (...) {
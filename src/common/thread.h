@@ -29,6 +29,7 @@
 #include <vector>
 #include <string>
 
+#include "config.h"
 #include "macros.h"
 
 class ubi_thread {
@@ -84,6 +85,7 @@ private:
   run_t body;
   const bool daemon;
   const std::string name;
+  ubiquant::NodeConfig node;  // of the starting thread, installed in the new one
 
   static std::vector<callback_t> &completion_callbacks();
 
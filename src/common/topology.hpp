@@ -0,0 +1,177 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+
+namespace ubiquant {
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+inline std::vector<int> parse_cpu_list(const std::string& str) {
+    std::vector<int> cpus;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty())
+            continue;
+        size_t dash = item.find('-');
+        int first = std::stoi(item.substr(0, dash));
+        int last = (dash == std::string::npos) ? first : std::stoi(item.substr(dash + 1));
+        for (int cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+/**
+ * CPU / NUMA layout of this host (read once from /sys/devices/system),
+ * and the cores assigned to each thread role by the `pin_<role>` config items.
+ *
+ * roles of the exchange: order_receiver, trade_sender, ack_sender, snapshot_writer, match_worker
+ * roles of the trader:   trader_controller, order_sender, trade_receiver, ack_receiver
+ * a role with several threads (match_worker, order_receiver, trade_sender, order_sender) uses its core list round-robin
+ */
+class CpuTopology {
+public:
+    static CpuTopology& get() {
+        static CpuTopology topology;
+        return topology;
+    }
+
+    inline int num_nodes() const { return num_nodes_; }
+
+    inline int node_of(int cpu) const {
+        return (cpu >= 0 && cpu < (int)node_of_cpu_.size()) ? node_of_cpu_[cpu] : 0;
+    }
+
+    inline int package_of(int cpu) const {
+        return (cpu >= 0 && cpu < (int)package_of_cpu_.size()) ? package_of_cpu_[cpu] : 0;
+    }
+
+    // core of the idx-th thread of a role, -1 if the role is not pinned
+    int role_cpu(const std::string& role, int idx = 0) const {
+        auto it = Config::thread_pinning.find(role);
+        if (it == Config::thread_pinning.end())
+            return -1;
+        std::vector<int> cpus = parse_cpu_list(it->second);
+        return cpus.empty() ? -1 : cpus[idx % cpus.size()];
+    }
+
+    // NUMA node of the idx-th thread of a role, -1 if the role is not pinned
+    int role_node(const std::string& role, int idx = 0) const {
+        int cpu = role_cpu(role, idx);
+        return cpu == -1 ? -1 : node_of(cpu);
+    }
+
+    void print() const {
+        logstream(LOG_EMPH) << "cpu topology: " << online_.size() << " cpus, " << num_nodes_ << " NUMA nodes" << LOG_endl;
+        for (int node = 0; node < num_nodes_; node++) {
+            std::stringstream ss;
+            for (int cpu : online_) {
+                if (node_of(cpu) == node)
+                    ss << " " << cpu;
+            }
+            logstream(LOG_EMPH) << "  node " << node << ":" << ss.str() << LOG_endl;
+        }
+        for (auto& [role, cpus] : Config::thread_pinning) {
+            logstream(LOG_EMPH) << "  pin " << role << " -> " << cpus << LOG_endl;
+        }
+    }
+
+private:
+    CpuTopology() {
+        std::string line;
+        if (read_line("/sys/devices/system/cpu/online", line))
+            online_ = parse_cpu_list(line);
+        if (online_.empty())
+            for (int cpu = 0; cpu < (int)sysconf(_SC_NPROCESSORS_ONLN); cpu++)
+                online_.push_back(cpu);
+
+        int max_cpu = 0;
+        for (int cpu : online_)
+            max_cpu = std::max(max_cpu, cpu);
+        node_of_cpu_.assign(max_cpu + 1, 0);
+        package_of_cpu_.assign(max_cpu + 1, 0);
+
+        for (int cpu : online_) {
+            if (read_line("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/physical_package_id", line))
+                package_of_cpu_[cpu] = std::stoi(line);
+        }
+
+        // hosts without NUMA support have no node directory: a single node
+        num_nodes_ = 1;
+        if (read_line("/sys/devices/system/node/online", line)) {
+            for (int node : parse_cpu_list(line)) {
+                std::string cpulist;
+                if (!read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", cpulist))
+                    continue;
+                for (int cpu : parse_cpu_list(cpulist)) {
+                    if (cpu <= max_cpu)
+                        node_of_cpu_[cpu] = node;
+                }
+                num_nodes_ = std::max(num_nodes_, node + 1);
+            }
+        }
+    }
+
+    static bool read_line(const std::string& path, std::string& line) {
+        std::ifstream ifs(path);
+        return ifs && std::getline(ifs, line) && !line.empty();
+    }
+
+    std::vector<int> online_;
+    std::vector<int> node_of_cpu_;
+    std::vector<int> package_of_cpu_;
+    int num_nodes_;
+};
+
+// pin the calling thread to the core of the idx-th thread of role, return its NUMA node (-1 if not pinned)
+inline int pin_thread(const std::string& role, int idx = 0) {
+    auto& topology = CpuTopology::get();
+    int cpu = topology.role_cpu(role, idx);
+    if (cpu == -1)
+        return -1;
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) != 0) {
+        logstream(LOG_WARNING) << "pin " << role << "[" << idx << "] to cpu " << cpu << " failed" << LOG_endl;
+        return -1;
+    }
+    logstream(LOG_EMPH) << "pin " << role << "[" << idx << "] -> cpu " << cpu << " (node " << topology.node_of(cpu)
+                        << ", package " << topology.package_of(cpu) << ")" << LOG_endl;
+    return topology.node_of(cpu);
+}
+
+// prefer (and move) the pages of [addr, addr + len) on node; no-op on single-node hosts or node == -1
+inline void bind_memory(const void* addr, size_t len, int node) {
+    if (node < 0 || len == 0 || CpuTopology::get().num_nodes() <= 1)
+        return;
+
+    constexpr int MPOL_PREFERRED_ = 1;
+    constexpr unsigned MPOL_MF_MOVE_ = 1 << 1;
+    const uintptr_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)addr & ~(page - 1);
+    uintptr_t end = ((uintptr_t)addr + len + page - 1) & ~(page - 1);
+    unsigned long nodemask[16] = {0};
+    nodemask[node / 64] |= 1ul << (node % 64);
+    if (syscall(SYS_mbind, start, end - start, MPOL_PREFERRED_, nodemask, sizeof(nodemask) * 8, MPOL_MF_MOVE_) != 0) {
+        logstream(LOG_DEBUG) << "mbind " << len << " bytes to node " << node << " failed" << LOG_endl;
+    }
+}
+
+template <class T, class A>
+inline void bind_memory(const std::vector<T, A>& v, int node) {
+    bind_memory(v.data(), v.size() * sizeof(T), node);
+}
+
+}  // namespace ubiquant
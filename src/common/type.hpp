@@ -4,6 +4,7 @@
 #include <memory>
 
 #include "common/config.h"
+#include "common/price.hpp"
 
 namespace ubiquant {
 
@@ -11,13 +12,13 @@ using stock_code_t = int;
 using order_id_t = int;
 using direction_t = int;
 using type_t = int;
-using price_t = double;
 using volume_t = int;
 using trade_idx_t = int;
 
 enum MSG_TYPE { ORDER_MSG = 1,
                 TRADE_MSG = 2,
-                ORDER_ACK_MSG = 3 };
+                ORDER_ACK_MSG = 3,
+                RESEND_MSG = 4 };
 
 template <typename T>
 void get_elem_from_buf(const char* buf, size_t& offset, T& elem) {
@@ -27,13 +28,14 @@ void get_elem_from_buf(const char* buf, size_t& offset, T& elem) {
 
 // stk_code, order id and trade index start at 1...
 
+// wire layout: 24 bytes, price in ticks (see common/price.hpp)
 struct Order {
     int stk_code;
     int order_id;
-    int direction;
-    int type;
-    double price;
+    price_t price;
     int volume;
+    int8_t direction;
+    int8_t type;
 
     void append_to_str(std::string& str) const {
         str.reserve(str.length() + sizeof(Order));
@@ -57,11 +59,12 @@ struct Order {
                order_id,
                direction,
                type,
-               price,
+               price_to_double(price),
                volume);
     }
 };
 
+// output layout of trade_res.*: 24 bytes, legacy double price
 struct Trade {
     int stk_code;
     int bid_id;
@@ -96,23 +99,38 @@ struct Trade {
 
 } __attribute__((packed));
 
+// wire layout of a trade produced by the exchange: 24 bytes, price in ticks
 struct CommTrade {
     int stk_code;
     int bid_id;
     int ask_id;
-    int dummy;
-    double price;
     int volume;
+    price_t price;
 
     void print() const {
         printf("CommTrade [%d] bid_id: %d\task_id: %d\tprice: %.2f\t, volume: %d\n",
                stk_code,
                bid_id,
                ask_id,
-               price,
+               price_to_double(price),
                volume);
     }
-} __attribute__((packed));
+};
+
+// the only place a price goes back to the legacy double
+inline Trade convert_commtrade_to_trade(const CommTrade& commTrade) {
+    return Trade{
+        stk_code : commTrade.stk_code,
+        bid_id : commTrade.bid_id,
+        ask_id : commTrade.ask_id,
+        price : price_to_double(commTrade.price),
+        volume : commTrade.volume
+    };
+}
+
+static_assert(sizeof(Order) == 24, "unexpected Order wire size");
+static_assert(sizeof(Trade) == 24, "unexpected Trade output size");
+static_assert(sizeof(CommTrade) == 24, "unexpected CommTrade wire size");
 
 struct OrderAck {
     int stk_code;
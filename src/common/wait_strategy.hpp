@@ -0,0 +1,142 @@
+#pragma once
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace ubiquant {
+
+// how a polling loop waits when an attempt finds nothing to do
+// (config: recv_wait_strategy / send_wait_strategy / match_wait_strategy)
+enum WAIT_MODE {
+    WAIT_SPIN = 0,        // busy spin, lowest latency, burns a core
+    WAIT_SPIN_YIELD = 1,  // spin, then sched_yield
+    WAIT_SPIN_PARK = 2,   // spin, then yield, then park on the caller's blocking wait, which producers wake,
+                          // or, for a loop without one (socket receivers), a timed sleep nothing wakes
+};
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+inline void futex_wait(std::atomic<uint32_t>* word, uint32_t expected, long timeout_us) {
+    struct timespec ts = {timeout_us / 1000000, (timeout_us % 1000000) * 1000};
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT_PRIVATE, expected, &ts, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<uint32_t>* word) {
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+/**
+ * Per-thread idle policy of a polling loop. A loop that owns a blocking primitive (condition variable,
+ * timed queue drain) calls backoff(), and blocks on its own primitive once backoff() returns false,
+ * so producers can wake it:
+ *   while (...) { if (try_something()) { waiter.reset(); ... } else if (!waiter.backoff()) queue.take(...); }
+ * A loop with nothing to block on that a producer could signal (a non-blocking socket receiver) calls idle(),
+ * which sleeps once the backoff is over; nothing wakes that sleep, so such a loop should block on its sockets
+ * instead (recv_mode 1) when latency matters.
+ */
+class WaitStrategy {
+public:
+    explicit WaitStrategy(int mode) : mode_(mode) {}
+
+    inline void reset() {
+        rounds_ = 0;
+        sleep_us_ = MIN_SLEEP_US;
+    }
+
+    // busy-wait one step, return false once the loop should park
+    inline bool backoff() {
+        if (mode_ == WAIT_SPIN || rounds_ < SPIN_ROUNDS) {
+            rounds_++;
+            cpu_relax();
+            return true;
+        }
+        if (mode_ == WAIT_SPIN_YIELD || rounds_ < SPIN_ROUNDS + YIELD_ROUNDS) {
+            rounds_++;
+            std::this_thread::yield();
+            return true;
+        }
+        return false;
+    }
+
+    inline void idle() {
+        if (!backoff())
+            sleep();
+    }
+
+    // a plain sleep (no futex, nothing wakes it) for a timeout that grows from 50us to 1ms while the loop stays idle
+    void sleep() {
+        usleep(sleep_us_);
+        sleep_us_ = std::min(sleep_us_ * 2, MAX_SLEEP_US);
+    }
+
+    inline int mode() const { return mode_; }
+
+private:
+    constexpr static int SPIN_ROUNDS = 1024;
+    constexpr static int YIELD_ROUNDS = 64;
+    constexpr static long MIN_SLEEP_US = 50;
+    constexpr static long MAX_SLEEP_US = 1000;
+
+    const int mode_;
+    int rounds_ = 0;
+    long sleep_us_ = MIN_SLEEP_US;
+};
+
+/**
+ * Console pause/resume of a long-lived loop, checked only between batches.
+ * The epoch is odd while paused; pause() returns once the loop has parked at a checkpoint,
+ * so the console can e.g. reset the sockets the loop uses. Only the console thread writes the epoch.
+ */
+class PauseEpoch {
+public:
+    // console thread, no-op if already paused
+    void pause() {
+        uint32_t e = epoch_.load(std::memory_order_relaxed);
+        if (e & 1)
+            return;
+        epoch_.store(++e, std::memory_order_release);
+        while (acked_.load(std::memory_order_acquire) != e) {
+            std::this_thread::yield();
+        }
+    }
+
+    // console thread, no-op if not paused
+    void resume() {
+        uint32_t e = epoch_.load(std::memory_order_relaxed);
+        if (!(e & 1))
+            return;
+        epoch_.store(e + 1, std::memory_order_release);
+        futex_wake(&epoch_);
+    }
+
+    // owner thread, between batches: a single load unless paused
+    inline void checkpoint() {
+        uint32_t e = epoch_.load(std::memory_order_acquire);
+        if (__builtin_expect(e & 1, 0))
+            park(e);
+    }
+
+private:
+    void park(uint32_t e) {
+        acked_.store(e, std::memory_order_release);
+        while (epoch_.load(std::memory_order_acquire) == e) {
+            futex_wait(&epoch_, e, 100000);
+        }
+    }
+
+    std::atomic<uint32_t> epoch_{0};
+    std::atomic<uint32_t> acked_{0};
+};
+
+}  // namespace ubiquant
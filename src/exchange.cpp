@@ -8,11 +8,15 @@
 #include <signal.h>
 
 #include "common/console.hpp"
+#include "common/huge_page.hpp"
 #include "common/monitor.hpp"
+#include "common/topology.hpp"
 
+#include "exchange/ack_sender.h"
 #include "exchange/order_receiver.h"
 #include "exchange/trade_sender.h"
 #include "exchange/exchange.h"
+#include "exchange/snapshot_writer.h"
 
 #include "utils/timer.hpp"
 #include "utils/util.h"
@@ -29,6 +33,7 @@ inline void finish_work() { work_flag = false; }
 
 void stop_network_sender() {
   Global<ExchangeTradeSender>::Get()->stop();
+  Global<ExchangeAckSender>::Get()->stop();
   std::cout << "Stop Exchange-Senders-" << Config::partition_idx << std::endl;
 }
 
@@ -40,12 +45,14 @@ void stop_network_receiver() {
 void restart_network() {
   Global<ExchangeOrderReceiver>::Get()->restart();
   Global<ExchangeTradeSender>::Get()->restart();
+  Global<ExchangeAckSender>::Get()->restart();
   std::cout << "Restart Exchange-" << Config::partition_idx << std::endl;
 }
 
 void reset_network() {
   Global<ExchangeOrderReceiver>::Get()->reset_network();
   Global<ExchangeTradeSender>::Get()->reset_network();
+  Global<ExchangeAckSender>::Get()->reset_network();
   std::cout << "Reset Exchange-" << Config::partition_idx << std::endl;
 }
 
@@ -53,7 +60,9 @@ void exit_system() {
   Global<LogBuffer>::Delete();
   Global<ExchangeOrderReceiver>::Delete();
   Global<ExchangeTradeSender>::Delete();
+  Global<ExchangeAckSender>::Delete();
   Global<Exchange>::Delete();
+  Global<ExchangeSnapshotWriter>::Delete();
 }
 
 }
@@ -118,13 +127,19 @@ int main(int argc, char *argv[])
 
     std::cout << "Exchange[" << Config::partition_idx << "] is starting..." << std::endl;
     print_config();
+    CpuTopology::get().print();
 
     Global<LogBuffer>::New();
     Global<ExchangeOrderReceiver>::New();
     Global<ExchangeTradeSender>::New();
+    Global<ExchangeAckSender>::New();
+    Global<ExchangeSnapshotWriter>::New();
     Global<Exchange>::New();
+    HugePages::get().report("Exchange[" + std::to_string(Config::partition_idx) + "]");
 
     Global<ExchangeTradeSender>::Get()->start();
+    Global<ExchangeAckSender>::Get()->start();
+    Global<ExchangeSnapshotWriter>::Get()->start();
     Global<ExchangeOrderReceiver>::Get()->start();
     Global<Exchange>::Get()->start();
 
@@ -0,0 +1,116 @@
+#include "ack_sender.h"
+
+namespace ubiquant {
+
+ExchangeAckSender::ExchangeAckSender()
+    : latest_order_ids_(new std::atomic<int>[Config::stock_num + 1]),
+      dirty_(new std::atomic<bool>[Config::stock_num + 1]),
+      dirty_stocks_(Config::stock_num + 1),
+      resend_queue_(Config::stock_num + 1),
+      ack_buffers_(MsgBuffer::bytes_for<OrderAck>(Config::stock_num)),
+      waiter_(Config::send_wait_strategy) {
+
+    // NOTICE: stock code starts from 1
+    for (int i = 0; i <= Config::stock_num; i++) {
+        latest_order_ids_[i].store(0, std::memory_order_relaxed);
+        dirty_[i].store(false, std::memory_order_relaxed);
+    }
+
+    // init msg senders
+    for (int i = 0; i < Config::trader_num; i++) {
+        auto& channels = Config::trader_port2exchange_port[i][Config::partition_idx];
+        ASSERT_MSG(ACK_CHANNEL < (int)channels.size(), "no ack channel configured for a trader:exchange link");
+        msg_senders_.push_back(std::make_shared<MessageSender>(
+            Config::exchanges_addr[Config::partition_idx],
+            Config::traders_addr[i],
+            std::make_pair(channels[ACK_CHANNEL].second, channels[ACK_CHANNEL].first)));
+    }
+}
+
+void ExchangeAckSender::stop() {
+    std::cout << "ExchangeAckSender pause" << std::endl;
+    pause_.pause();
+    std::cout << "ExchangeAckSender pause success" << std::endl;
+}
+
+void ExchangeAckSender::restart() {
+    std::cout << "ExchangeAckSender resume" << std::endl;
+    pause_.resume();
+    std::cout << "ExchangeAckSender resume success" << std::endl;
+}
+
+void ExchangeAckSender::reset_network() {
+    // reset msg senders
+    for (int i = 0; i < Config::trader_num; i++) {
+        auto& channels = Config::trader_port2exchange_port[i][Config::partition_idx];
+        msg_senders_[i]->reset_port({channels[ACK_CHANNEL].second, channels[ACK_CHANNEL].first});
+    }
+    after_reset = true;
+}
+
+void ExchangeAckSender::send_to_traders(MsgBuffer* msg) {
+    // every trader gets a zero-copy frame of the same buffer
+    for (size_t idx = 0; idx < msg_senders_.size(); idx++) {
+        // retry until sent, a paused sender (e.g. while the network is reset) resumes the same message
+        while (!msg_senders_[idx]->send(msg)) {
+            pause_.checkpoint();
+        }
+    }
+}
+
+void ExchangeAckSender::run() {
+    int node = pin_thread("ack_sender");
+    dirty_stocks_.bind_memory(node);
+    logstream(LOG_EMPH) << "Exchange AckSender is running..." << LOG_endl;
+    while (true) {
+        pause_.checkpoint();
+
+        size_t cnt = resend_queue_.drain([this](MsgBuffer* msg) {
+            send_to_traders(msg);
+            msg->release();
+        }, SEND_BATCH);
+
+        if (!dirty_stocks_.empty()) {
+            // one msg for all the dirty stocks
+            MsgBuffer* msg = ack_buffers_.acquire(MsgBuffer::bytes_for<OrderAck>(Config::stock_num));
+            msg->begin(MSG_TYPE::ORDER_ACK_MSG);
+            cnt += dirty_stocks_.drain([this, msg](int stk_code) {
+                // clear the mark before reading the order id: a later ack either is read here or queues the stock again
+                dirty_[stk_code].exchange(false, std::memory_order_acq_rel);
+                if (stk_code == RESEND_PENDING)
+                    return;  // drained by the next round
+                OrderAck ack;
+                ack.stk_code = stk_code;
+                ack.order_id = latest_order_ids_[stk_code].load(std::memory_order_acquire);
+                msg->append(&ack, 1);
+            }, Config::stock_num + 1);
+            if (msg->count() != 0)
+                send_to_traders(msg);
+            msg->release();
+        }
+
+        if (cnt != 0)
+            waiter_.reset();
+        else if (!waiter_.backoff())
+            dirty_stocks_.wait_for(PARK_TIMEOUT);
+    }
+}
+
+void ExchangeAckSender::put_order_ack(const OrderAck& ack) {
+    // a stock is matched by one worker at a time, so the order id only grows
+    latest_order_ids_[ack.stk_code].store(ack.order_id, std::memory_order_release);
+    if (!dirty_[ack.stk_code].exchange(true, std::memory_order_acq_rel))
+        dirty_stocks_.put(ack.stk_code);
+}
+
+void ExchangeAckSender::put_resend_request(const OrderAck& ack) {
+    MsgBuffer* msg = ack_buffers_.acquire(MsgBuffer::bytes_for<OrderAck>(1));
+    msg->begin(MSG_TYPE::RESEND_MSG);
+    msg->append(&ack, 1);
+    resend_queue_.put(msg);
+    // wakes a parked sender
+    if (!dirty_[RESEND_PENDING].exchange(true, std::memory_order_acq_rel))
+        dirty_stocks_.put(RESEND_PENDING);
+}
+
+}  // namespace ubiquant
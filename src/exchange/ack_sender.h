@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "common/mpsc_ring.hpp"
+#include "common/thread.h"
+#include "common/topology.hpp"
+#include "common/wait_strategy.hpp"
+#include "common/type.hpp"
+#include "network/msg_sender.h"
+
+namespace ubiquant {
+
+/**
+ * Order acks on their own channel (ACK_CHANNEL) and thread, so that the traders' sliding windows
+ * advance regardless of how many trades are queued in ExchangeTradeSender.
+ *
+ * Acks are coalesced per stock: a matching worker only records the latest consumed order id of
+ * the stock and marks the stock dirty, the sender sends one ack per dirty stock with its latest
+ * order id (an ack of order n implies all the orders before n).
+ * Resend requests are never coalesced and go out before any ack.
+ * An idle sender parks on dirty_stocks_, which both kinds of puts wake (a resend request queues stock 0).
+ */
+class ExchangeAckSender : public ubi_thread {
+public:
+    ExchangeAckSender();
+
+    void run() override;
+
+    // matching worker of ack.stk_code, orders of a stock are acked in order
+    void put_order_ack(const OrderAck& ack);
+
+    // ack.order_id is the first order id the trader has to resend
+    void put_resend_request(const OrderAck& ack);
+
+    void stop();
+    void restart();
+    void reset_network();
+
+protected:
+    constexpr static size_t SEND_BATCH = 64;
+    // bounds how long a console pause waits for a parked sender
+    constexpr static std::chrono::microseconds PARK_TIMEOUT{10000};
+    // dirty stock queued by put_resend_request (stock codes start from 1)
+    constexpr static int RESEND_PENDING = 0;
+
+    void send_to_traders(MsgBuffer* msg);
+
+    // socket client
+    std::vector<std::shared_ptr<MessageSender>> msg_senders_;
+
+    // latest consumed order id, and whether the stock is queued in dirty_stocks_ (by stk_code, or RESEND_PENDING)
+    std::unique_ptr<std::atomic<int>[]> latest_order_ids_;
+    std::unique_ptr<std::atomic<bool>[]> dirty_;
+    // each stock is queued at most once, so the ring never fills up
+    MpscRing<int> dirty_stocks_;
+
+    MpscRing<MsgBuffer*> resend_queue_;
+
+    // one ack msg holds an ack of every stock at most
+    MsgBufferPool ack_buffers_;
+
+    WaitStrategy waiter_;
+
+    // console pause, checked between messages
+    PauseEpoch pause_;
+};
+
+}  // namespace ubiquant
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+#include "record.hpp"
+
+namespace ubiquant {
+
+/**
+ * @brief 单只股票集中申报簿的二进制快照
+ *
+ * 文件格式：Header + num_buy 个 Record + num_sell 个 Record，
+ * 挂单按照优先级（价格优先、时间优先）排列，按顺序重新插入即可恢复申报簿。
+ * 写入时先写临时文件再 rename，保证磁盘上总是一个完整的快照。
+ */
+struct BookSnapshot {
+    constexpr static uint32_t MAGIC = 0x4b4f4f42;  // "BOOK"
+
+    struct Header {
+        uint32_t magic;
+        int stk_code;
+        int last_commit_order_id;
+        uint32_t num_buy;
+        uint32_t num_sell;
+    };
+
+    int stk_code = 0;
+    int last_commit_order_id = 0;
+    std::vector<Record> buy_decls;
+    std::vector<Record> sell_decls;
+
+    /* 正在由 ExchangeSnapshotWriter 写盘，此时 StockExchange 不能复用该缓冲区 */
+    std::atomic<bool> in_flight{false};
+
+    static std::string fname(int stk_code) {
+        return Config::snapshot_folder + "book." + std::to_string(stk_code) + ".snap";
+    }
+
+    static std::string journal_fname(int stk_code) {
+        return Config::snapshot_folder + "journal." + std::to_string(stk_code);
+    }
+
+    static std::string trades_fname(int stk_code) {
+        return Config::snapshot_folder + "trades." + std::to_string(stk_code);
+    }
+
+    bool dump(const std::string& path) const {
+        std::string tmp_path = path + ".tmp";
+        int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0640);
+        if (fd == -1)
+            return false;
+
+        Header header = {MAGIC, stk_code, last_commit_order_id, (uint32_t)buy_decls.size(), (uint32_t)sell_decls.size()};
+        bool ok = writeAll(fd, &header, sizeof(header))
+               && writeAll(fd, buy_decls.data(), buy_decls.size() * sizeof(Record))
+               && writeAll(fd, sell_decls.data(), sell_decls.size() * sizeof(Record))
+               && fdatasync(fd) == 0;
+        close(fd);
+
+        return ok && rename(tmp_path.c_str(), path.c_str()) == 0;
+    }
+
+    bool load(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+            return false;
+
+        Header header;
+        bool ok = readAll(fd, &header, sizeof(header)) && header.magic == MAGIC;
+        if (ok) {
+            stk_code = header.stk_code;
+            last_commit_order_id = header.last_commit_order_id;
+            buy_decls.resize(header.num_buy);
+            sell_decls.resize(header.num_sell);
+            ok = readAll(fd, buy_decls.data(), buy_decls.size() * sizeof(Record))
+              && readAll(fd, sell_decls.data(), sell_decls.size() * sizeof(Record));
+        }
+        close(fd);
+        return ok;
+    }
+
+    static bool writeAll(int fd, const void* buf, size_t len) {
+        const char* p = (const char*)buf;
+        while (len) {
+            ssize_t n = write(fd, p, len);
+            if (n <= 0)
+                return false;
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    static bool readAll(int fd, void* buf, size_t len) {
+        char* p = (char*)buf;
+        while (len) {
+            ssize_t n = read(fd, p, len);
+            if (n <= 0)
+                return false;
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+};
+
+}  // namespace ubiquant
@@ -16,16 +16,16 @@
 
 namespace ubiquant {
 
-static void printTrade(Trade *t) {
+static void printTrade(CommTrade *t) {
     printf("[%d] %d <- %d\t%.2f\t* %d\n",
         t->stk_code,
         t->bid_id,
         t->ask_id,
-        t->price,
+        price_to_double(t->price),
         t->volume);
 }
 
-static bool diffTradeList(std::vector<Trade>& v1, std::vector<Trade>& v2)
+static bool diffTradeList(std::vector<CommTrade>& v1, std::vector<CommTrade>& v2)
 {
     int size1 = v1.size();
     int size2 = v2.size();
@@ -52,7 +52,7 @@ static bool diffTradeList(std::vector<Trade>& v1, std::vector<Trade>& v2)
     return true;
 }
 
-static void printTradeList(std::vector<Trade>& tv) {
+static void printTradeList(std::vector<CommTrade>& tv) {
     for (size_t i = 0; i < tv.size(); ++i) {
         printf("%ld:\t", i);
         printTrade(&tv[i]);
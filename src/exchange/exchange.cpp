@@ -1,5 +1,10 @@
 #include "exchange.h"
 
+#include <algorithm>
+#include <thread>
+
+#include "common/loader.hpp"
+
 namespace ubiquant {
 
 Exchange::Exchange() {
@@ -12,30 +17,84 @@ Exchange::Exchange() {
         }
     }
 
+    // load price limits, which bound the price ladder of each stock
+    init_loader();
+    auto price_limits = load_prev_close(Config::partition_idx);
+
+    // 0: one worker per stock, bounded by the cores
+    int num_workers = Config::match_worker_num;
+    if (num_workers <= 0)
+        num_workers = std::max(1, std::min((int)stk_codes.size(), (int)std::thread::hardware_concurrency() / 2));
+    scheduler = std::make_unique<MatchScheduler>(num_workers);
+
     for (auto code : stk_codes) {
-        stock_exchange[code] = std::make_shared<StockExchange>(code);
+        stock_exchange[code] = std::make_shared<StockExchange>(code, price_limits[0][code - 1], price_limits[1][code - 1]);
         order_buffer.emplace(std::make_pair(code, Config::sliding_window_size));
+        stock_exchange[code]->setOrderWindow(&order_buffer.at(code));
+        scheduler->addStock(code, stock_exchange[code].get(), &order_buffer.at(code));
+    }
+
+    if (Config::snapshot_recover) {
+        recoverFromSnapshot();
     }
 };
 
-Exchange::~Exchange() {
+void Exchange::recoverFromSnapshot() {
     for (auto& [code, exchange] : stock_exchange) {
-        exchange->join();
+        BookSnapshot snapshot;
+        if (!snapshot.load(BookSnapshot::fname(code)) || snapshot.stk_code != code) {
+            int journal_order_id = ExchangeSnapshotWriter::truncate_journal(code, 0);
+            logstream(LOG_WARNING) << "no snapshot of stock " << code << ", restart from the first order"
+                                   << " (journal: " << journal_order_id << ")" << LOG_endl;
+            continue;
+        }
+
+        int journal_order_id = ExchangeSnapshotWriter::truncate_journal(code, snapshot.last_commit_order_id);
+        exchange->restoreSnapshot(snapshot);
+        // the next order expected is last_commit_order_id + 1, whose window position is last_commit_order_id
+        order_buffer.at(code).reset(snapshot.last_commit_order_id);
+        logstream(LOG_EMPH) << "stock " << code << " restored from snapshot at order " << snapshot.last_commit_order_id
+                            << " (journal: " << journal_order_id << ", "
+                            << snapshot.buy_decls.size() + snapshot.sell_decls.size() << " resting orders)" << LOG_endl;
     }
 }
 
+Exchange::~Exchange() {
+    scheduler->stop();
+}
+
 void Exchange::start() {
-    for (auto& [code, exchange] : stock_exchange) {
-        exchange->start();
+    if (Config::snapshot_recover) {
+        for (auto& [code, exchange] : stock_exchange) {
+            // ask traders to resend everything after the restored snapshot
+            OrderAck resend;
+            resend.stk_code = code;
+            resend.order_id = exchange->getLastCommitOrderId() + 1;
+            Global<ExchangeAckSender>::Get()->put_resend_request(resend);
+            Global<ExchangeTradeSender>::Get()->put_resend_request(resend);
+
+            // trades of the last snapshot interval may not have reached the traders, send them again
+            // before any new trade (traders drop what they already have)
+            ExchangeSnapshotWriter::replay_trades(code, [](const std::vector<CommTrade>& trades) {
+                Global<ExchangeTradeSender>::Get()->put_trades(trades);
+            });
+        }
     }
+
+    logstream(LOG_EMPH) << "Exchange matches " << stock_exchange.size() << " stocks on "
+                        << scheduler->getWorkerNum() << " workers" << LOG_endl;
+    scheduler->start();
 }
 
 // Order receiver will call this function
-void Exchange::receiveOrder(Order& order) {
+void Exchange::receiveOrder(const Order& order) {
     // NOTICE: order id starts from 1
-    int window_idx = (order.order_id-1) % Config::sliding_window_size;
+    // duplicated or out-of-window orders (resent after an exchange restart) are dropped
     try {
-        order_buffer.at(order.stk_code).put(order, window_idx);
+        auto& window = order_buffer.at(order.stk_code);
+        // wake the matching worker only when the stock can make progress
+        if (window.offer(order, order.order_id - 1) && window.ready())
+            scheduler->notify(order.stk_code);
     }
     catch(...) {
         std::cerr << "throwing an exception when at: stk code=" << order.stk_code << std::endl;
@@ -44,25 +103,17 @@ void Exchange::receiveOrder(Order& order) {
 }
 
 // Stock exchange will call this function
-std::vector<Order> Exchange::comsumeOrder(int stk_code) {
-    std::vector<Order> orders;
-    Order order;
-    while(order_buffer[stk_code].poll(order)) {
-        orders.push_back(order);
-    }
+void Exchange::ackOrder(int stk_code, int order_id) {
     // generate order ack and push into msg queue
-    if(!orders.empty()) {
-        OrderAck ack;
-        ack.order_id = orders.back().order_id;
-        ack.stk_code = stk_code;
-        Global<ExchangeTradeSender>::Get()->put_order_ack(ack);
-    }
-    return orders;
+    OrderAck ack;
+    ack.order_id = order_id;
+    ack.stk_code = stk_code;
+    Global<ExchangeAckSender>::Get()->put_order_ack(ack);
 }
 
 // Stock exchange will call this function
-void Exchange::produceTrade(Trade& new_trade) {
-    Global<ExchangeTradeSender>::Get()->put_trade(new_trade);
+void Exchange::produceTrades(const std::vector<CommTrade>& new_trades) {
+    Global<ExchangeTradeSender>::Get()->put_trades(new_trades);
 }
 
 /* For local processing */
@@ -72,6 +123,7 @@ int Exchange::handleSingleOrder(Order& order) {
 
     order.print();
     int ret = stock_exchange[order.stk_code]->receiveOrder(order);
+    stock_exchange[order.stk_code]->flushTrades();
     // if (ret != 0) {
     //     log("error number: %d\n", ret);
     // }
@@ -4,8 +4,11 @@
 #include "common/thread.h"
 #include "common/block_queue.hpp"
 #include "common/sliding_window.hpp"
+#include "ack_sender.h"
 #include "trade_sender.h"
+#include "snapshot_writer.h"
 #include "stock_exchange.h"
+#include "match_scheduler.h"
 #include "debug.hpp"
 
 namespace ubiquant {
@@ -16,6 +19,8 @@ class Exchange {
 private:
     std::unordered_map<int, std::shared_ptr<StockExchange>> stock_exchange; /* [0] is not used */
     std::unordered_map<int, SlidingWindow<Order>> order_buffer;
+    /* 撮合线程池，所有股票共享 */
+    std::unique_ptr<MatchScheduler> scheduler;
 
 public:
     Exchange();
@@ -24,14 +29,22 @@ public:
 
     void start();
 
+    // restore every stock from its latest snapshot (Config::snapshot_recover)
+    void recoverFromSnapshot();
+
     // Order receiver will call this function
-    void receiveOrder(Order& order);
+    void receiveOrder(const Order& order);
+
+    // Stock exchange will call this function
+    inline SlidingWindow<Order>& getOrderBuffer(int stk_code) {
+        return order_buffer.at(stk_code);
+    }
 
     // Stock exchange will call this function
-    std::vector<Order> comsumeOrder(int stk_code);
+    void ackOrder(int stk_code, int order_id);
 
     // Stock exchange will call this function
-    void produceTrade(Trade& new_trade);
+    void produceTrades(const std::vector<CommTrade>& new_trades);
 
     inline std::shared_ptr<StockExchange> getStockExchange(int stk_code) {
         return stock_exchange[stk_code];
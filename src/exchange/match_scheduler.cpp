@@ -0,0 +1,193 @@
+#include "match_scheduler.h"
+
+#include <chrono>
+
+#include "stock_exchange.h"
+
+namespace ubiquant {
+
+MatchScheduler::MatchScheduler(int num_workers) {
+    ASSERT_MSG(num_workers > 0, "match scheduler needs at least one worker");
+    for (int i = 0; i < num_workers; i++) {
+        workers_.emplace_back(new MatchWorker(*this, i));
+    }
+    // NOTICE: stk_code starts from 1
+    tasks_.resize(Config::stock_num + 1);
+}
+
+MatchScheduler::~MatchScheduler() {
+    stop();
+}
+
+void MatchScheduler::addStock(int stk_code, StockExchange* exchange, SlidingWindow<Order>* window) {
+    auto task = std::make_unique<StockTask>();
+    task->stk_code = stk_code;
+    task->exchange = exchange;
+    task->window = window;
+    // spread the stocks over the workers, stealing rebalances them later
+    task->owner.store(num_stocks_++ % (int)workers_.size());
+    tasks_[stk_code] = std::move(task);
+}
+
+void MatchScheduler::start() {
+    // place each book and window on the NUMA node of the worker that owns the stock first
+    for (auto& task : tasks_) {
+        if (!task)
+            continue;
+        int node = CpuTopology::get().role_node("match_worker", task->owner.load());
+        task->exchange->bindMemory(node);
+        task->window->bind_memory(node);
+    }
+
+    running_.store(true);
+    for (auto& worker : workers_) {
+        worker->start();
+    }
+
+    // orders may have arrived before the workers are up
+    for (auto& task : tasks_) {
+        if (task && task->window->ready() && !task->scheduled.exchange(true))
+            enqueue(task.get());
+    }
+}
+
+void MatchScheduler::stop() {
+    if (!running_.exchange(false))
+        return;
+
+    for (auto& worker : workers_) {
+        {
+            std::lock_guard<std::mutex> lock(worker->m);
+        }
+        worker->cv.notify_all();
+    }
+    for (auto& worker : workers_) {
+        worker->join();
+    }
+}
+
+void MatchScheduler::notify(int stk_code) {
+    StockTask* task = tasks_[stk_code].get();
+    // pairs with the fence in workerLoop: either the worker sees the published order, or we see scheduled == false
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // fast path: the stock is already queued or being processed, its worker will see the order
+    if (task->scheduled.load(std::memory_order_relaxed))
+        return;
+    if (!task->scheduled.exchange(true))
+        enqueue(task);
+}
+
+void MatchScheduler::enqueue(StockTask* task) {
+    MatchWorker& worker = *workers_[task->owner.load(std::memory_order_relaxed)];
+    bool sleeping;
+    {
+        std::lock_guard<std::mutex> lock(worker.m);
+        worker.ready.push_back(task);
+        sleeping = worker.sleeping;
+    }
+
+    if (sleeping)
+        worker.cv.notify_one();
+    else
+        wakeIdle();  // the owner is busy, let an idle worker steal the stock
+}
+
+void MatchScheduler::wakeIdle() {
+    for (auto& worker : workers_) {
+        bool woken = false;
+        {
+            // a worker already hinted may not have woken yet, hint the next one instead
+            std::lock_guard<std::mutex> lock(worker->m);
+            if (worker->sleeping && !worker->steal_hint) {
+                worker->steal_hint = true;
+                woken = true;
+            }
+        }
+        if (woken) {
+            worker->cv.notify_one();
+            return;
+        }
+    }
+}
+
+MatchScheduler::StockTask* MatchScheduler::popLocal(int id) {
+    MatchWorker& worker = *workers_[id];
+    std::lock_guard<std::mutex> lock(worker.m);
+    if (worker.ready.empty())
+        return nullptr;
+    StockTask* task = worker.ready.front();
+    worker.ready.pop_front();
+    return task;
+}
+
+MatchScheduler::StockTask* MatchScheduler::steal(int id) {
+    int n = workers_.size();
+    for (int i = 1; i < n; i++) {
+        MatchWorker& victim = *workers_[(id + i) % n];
+        std::lock_guard<std::mutex> lock(victim.m);
+        if (victim.ready.empty())
+            continue;
+        // take from the back, the victim keeps working from the front
+        StockTask* task = victim.ready.back();
+        victim.ready.pop_back();
+        return task;
+    }
+    return nullptr;
+}
+
+void MatchScheduler::workerLoop(int id) {
+    pin_thread("match_worker", id);
+    logstream(LOG_EMPH) << "Exchange MatchWorker [" << id << "] is running..." << LOG_endl;
+    MatchWorker& self = *workers_[id];
+    WaitStrategy waiter(Config::match_wait_strategy);
+    StockTask* task = nullptr;
+    while (running_.load(std::memory_order_acquire)) {
+        if (task == nullptr)
+            task = popLocal(id);
+        if (task == nullptr && (task = steal(id)) != nullptr)
+            task->owner.store(id, std::memory_order_relaxed);
+
+        if (task == nullptr) {
+            if (waiter.backoff())
+                continue;
+            // park: notify() wakes the owner, or an idle worker to steal
+            bool hinted;
+            {
+                std::unique_lock<std::mutex> lock(self.m);
+                self.sleeping = true;
+                self.cv.wait_for(lock, std::chrono::microseconds(STEAL_INTERVAL_US), [&] {
+                    return !self.ready.empty() || self.steal_hint || !running_.load(std::memory_order_acquire);
+                });
+                self.sleeping = false;
+                hinted = self.steal_hint;
+                self.steal_hint = false;
+            }
+            if (hinted && (task = steal(id)) != nullptr)
+                task->owner.store(id, std::memory_order_relaxed);
+            continue;
+        }
+        waiter.reset();
+
+        task->exchange->process();
+
+        if (task->window->ready()) {
+            // still busy: keep the stock on this worker, never queued (and never stolen) while it is alone here,
+            // otherwise behind the stocks already queued
+            std::lock_guard<std::mutex> lock(self.m);
+            if (!self.ready.empty()) {
+                self.ready.push_back(task);
+                task = nullptr;
+            }
+            continue;
+        }
+
+        // release the stock, then check again: an order may have arrived before scheduled was cleared
+        task->scheduled.store(false);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (task->window->ready() && !task->scheduled.exchange(true))
+            enqueue(task);
+        task = nullptr;
+    }
+}
+
+}  // namespace ubiquant
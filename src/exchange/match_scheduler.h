@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "common/config.h"
+#include "common/sliding_window.hpp"
+#include "common/thread.h"
+#include "common/topology.hpp"
+#include "common/wait_strategy.hpp"
+#include "common/type.hpp"
+
+namespace ubiquant {
+
+class StockExchange;
+
+/**
+ * @brief 撮合线程池：固定数量的 worker 处理所有股票
+ *
+ * 每只股票在任一时刻至多位于一个 worker 的就绪队列中（scheduled 标志），
+ * 因此同一只股票的 order 总是被串行处理，commit 顺序不变。
+ * 接收线程把 order 放入窗口后调用 notify()，只有窗口队首就绪且股票尚未被调度时才入队，
+ * 入队到该股票当前所属（owner）的 worker；owner 正忙时唤醒一个空闲 worker 来窃取。
+ * worker 处理完一批后，若窗口仍就绪则把股票放回自己的队尾（热门股票留在原 worker），
+ * 空闲 worker 从其他 worker 的队尾整只窃取股票，并成为它新的 owner。
+ */
+class MatchScheduler {
+public:
+    explicit MatchScheduler(int num_workers);
+    ~MatchScheduler();
+
+    // 只能在 start() 之前调用
+    void addStock(int stk_code, StockExchange* exchange, SlidingWindow<Order>* window);
+
+    void start();
+    void stop();
+
+    // Order receiver will call this function (after the order is in the window)
+    void notify(int stk_code);
+
+    inline int getWorkerNum() const { return (int)workers_.size(); }
+
+private:
+    /* 空闲 worker 等待的最长时间，超时后重新尝试窃取 */
+    constexpr static int STEAL_INTERVAL_US = 1000;
+
+    struct StockTask {
+        int stk_code;
+        StockExchange* exchange;
+        SlidingWindow<Order>* window;
+        /* 已在某个就绪队列中或正在被处理 */
+        std::atomic<bool> scheduled{false};
+        /* 所属 worker，窃取后改为窃取者 */
+        std::atomic<int> owner{0};
+    };
+
+    class MatchWorker : public ubi_thread {
+    public:
+        MatchWorker(MatchScheduler& scheduler, int id) : scheduler_(scheduler), id_(id) {}
+
+        void run() override { scheduler_.workerLoop(id_); }
+
+        std::mutex m;
+        std::condition_variable cv;
+        std::deque<StockTask*> ready;
+        bool sleeping = false;
+        /* wakeIdle() 叫醒它去窃取其他 worker 的股票 */
+        bool steal_hint = false;
+
+    private:
+        MatchScheduler& scheduler_;
+        int id_;
+    };
+
+    void workerLoop(int id);
+
+    void enqueue(StockTask* task);
+    StockTask* popLocal(int id);
+    StockTask* steal(int id);
+    void wakeIdle();
+
+    std::vector<std::unique_ptr<MatchWorker>> workers_;
+    /* 按 stk_code 索引，[0] 不使用 */
+    std::vector<std::unique_ptr<StockTask>> tasks_;
+    int num_stocks_ = 0;
+
+    std::atomic<bool> running_{false};
+};
+
+}  // namespace ubiquant
@@ -6,72 +6,92 @@
 namespace ubiquant {
 
 ExchangeOrderReceiver::ExchangeOrderReceiver() {
-
-    pthread_spin_init(&recv_lock, 0);
-
-    // init msg receivers
-    std::vector<int> ports;
+    // one receiver per order channel, as many as the links configure
+    size_t num_channels = 0;
     for (int i = 0; i < Config::trader_num; i++) {
-        ports.push_back(Config::trader_port2exchange_port[i][Config::partition_idx][0].second);
-        ports.push_back(Config::trader_port2exchange_port[i][Config::partition_idx][1].second);
+        num_channels = std::max(num_channels, order_channels(i, Config::partition_idx).size());
+    }
+    for (size_t slot = 0; slot < num_channels; slot++) {
+        channels_.emplace_back(new ChannelReceiver(slot));
+    }
+}
+
+void ExchangeOrderReceiver::start() {
+    for (auto& channel : channels_) {
+        channel->start();
     }
-    msg_receiver_ = std::make_shared<MessageReceiver>(Config::exchanges_addr[Config::partition_idx], ports);
 }
 
 void ExchangeOrderReceiver::stop() {
-    std::cout << "ExchangeOrderReceiver Lock recv lock" << std::endl;
-    pthread_spin_lock(&recv_lock);
-    std::cout << "ExchangeOrderReceiver Lock recv lock success" << std::endl;
+    std::cout << "ExchangeOrderReceiver pause" << std::endl;
+    for (auto& channel : channels_) {
+        channel->stop();
+    }
+    std::cout << "ExchangeOrderReceiver pause success" << std::endl;
 }
 
 void ExchangeOrderReceiver::restart() {
-    std::cout << "ExchangeOrderReceiver unlock recv lock" << std::endl;
-    pthread_spin_unlock(&recv_lock);
-    std::cout << "ExchangeOrderReceiver unlock recv lock success" << std::endl;
+    std::cout << "ExchangeOrderReceiver resume" << std::endl;
+    for (auto& channel : channels_) {
+        channel->restart();
+    }
+    std::cout << "ExchangeOrderReceiver resume success" << std::endl;
 }
 
 void ExchangeOrderReceiver::reset_network() {
     // reset msg receivers
+    for (auto& channel : channels_) {
+        channel->reset_network();
+    }
+}
+
+ExchangeOrderReceiver::ChannelReceiver::ChannelReceiver(int slot) : slot_(slot), waiter_(Config::recv_wait_strategy) {
+    msg_receiver_ = std::make_shared<MessageReceiver>(Config::exchanges_addr[Config::partition_idx], ports(slot_));
+}
+
+std::vector<int> ExchangeOrderReceiver::ChannelReceiver::ports(int slot) {
+    // the slot-th order channel of every trader
     std::vector<int> ports;
     for (int i = 0; i < Config::trader_num; i++) {
-        ports.push_back(Config::trader_port2exchange_port[i][Config::partition_idx][0].second);
-        ports.push_back(Config::trader_port2exchange_port[i][Config::partition_idx][1].second);
+        std::vector<int> channels = order_channels(i, Config::partition_idx);
+        if (slot < (int)channels.size())
+            ports.push_back(Config::trader_port2exchange_port[i][Config::partition_idx][channels[slot]].second);
     }
-    msg_receiver_->reset_port(ports);
+    return ports;
 }
 
-void ExchangeOrderReceiver::run() {
-    logstream(LOG_EMPH) << "Exchange OrderReceiver is running..." << LOG_endl;
-    Monitor monitor;
-    monitor.start_thpt();
+void ExchangeOrderReceiver::ChannelReceiver::run() {
+    pin_thread("order_receiver", slot_);
+    logstream(LOG_EMPH) << "Exchange OrderReceiver [" << slot_ << "] is running..." << LOG_endl;
+    monitor_.start_thpt();
+    RecvFrame frame;
     while (true) {
-        std::string msg;
-        bool res = false;
-        while (!res) {
-            pthread_spin_lock(&recv_lock);
-            res = msg_receiver_->tryrecv(msg);
-            pthread_spin_unlock(&recv_lock);
-            // if(unlikely(!res)) {
-            //     std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            // }
+        pause_.checkpoint();
+        if (Config::recv_mode == RECV_POLL) {
+            msg_receiver_->poll_drain(frame, [this](RecvFrame& frame) {
+                process_msg(MsgView(frame.data(), frame.size()));
+            }, Config::recv_poll_timeout_ms);
+            continue;
         }
 
-        // deserialize orders
-        size_t offset = 0;
-        uint32_t msg_code = 0;
-        get_elem_from_buf(msg.c_str(), offset, msg_code);
-        ASSERT_MSG(msg_code == MSG_TYPE::ORDER_MSG, "Wrong message type!");
-        uint32_t cnt = 0;
-        get_elem_from_buf(msg.c_str(), offset, cnt);
-        Order order;
-        for (uint32_t i = 0; i < cnt; i++) {
-            get_elem_from_buf(msg.c_str(), offset, order);
-            Global<Exchange>::Get()->receiveOrder(order);
-            monitor.add_cnt();
+        if (!msg_receiver_->tryrecv(frame)) {
+            waiter_.idle();
+            continue;
         }
-        monitor.print_timely_thpt("Order Receiver Throughput");
+        waiter_.reset();
+        process_msg(MsgView(frame.data(), frame.size()));
+    }
+    monitor_.end_thpt();
+}
+
+void ExchangeOrderReceiver::ChannelReceiver::process_msg(const MsgView& msg) {
+    // orders go from the frame straight into the order windows
+    ASSERT_MSG(msg.msg_code() == MSG_TYPE::ORDER_MSG, "Wrong message type!");
+    for (const Order& order : msg.records<Order>()) {
+        Global<Exchange>::Get()->receiveOrder(order);
+        monitor_.add_cnt();
     }
-    monitor.end_thpt();
+    monitor_.print_timely_thpt("Order Receiver Throughput");
 }
 
 }  // namespace ubiquant
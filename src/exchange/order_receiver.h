@@ -4,27 +4,60 @@
 
 #include "common/type.hpp"
 #include "common/global.hpp"
+#include "common/monitor.hpp"
 #include "common/thread.h"
+#include "common/topology.hpp"
+#include "common/wait_strategy.hpp"
 #include "network/msg_receiver.h"
 
 namespace ubiquant {
 
-class ExchangeOrderReceiver : public ubi_thread {
+/**
+ * Order receiving side of the exchange: one thread per order channel, each draining that channel
+ * of every trader. Traders stripe orders over the channels by stock, so all orders of a stock
+ * arrive through the same channel thread; the order windows accept concurrent producers.
+ */
+class ExchangeOrderReceiver {
 public:
     ExchangeOrderReceiver();
 
-    void run() override;
+    void start();
 
     void stop();
     void restart();
     void reset_network();
 
 protected:
-    // socket server
-    std::shared_ptr<MessageReceiver> msg_receiver_;
+    class ChannelReceiver : public ubi_thread {
+    public:
+        // slot: position of the channel among the order channels of each trader:exchange link
+        explicit ChannelReceiver(int slot);
 
-    // receiver pause lock
-    pthread_spinlock_t recv_lock;
+        void run() override;
+
+        void stop() { pause_.pause(); }
+        void restart() { pause_.resume(); }
+        void reset_network() { msg_receiver_->reset_port(ports(slot_)); }
+
+        static std::vector<int> ports(int slot);
+
+    private:
+        void process_msg(const MsgView& msg);
+
+        int slot_;
+
+        // socket server
+        std::shared_ptr<MessageReceiver> msg_receiver_;
+
+        WaitStrategy waiter_;
+
+        Monitor monitor_;
+
+        // console pause, checked between messages
+        PauseEpoch pause_;
+    };
+
+    std::vector<std::unique_ptr<ChannelReceiver>> channels_;
 };
 
 }  // namespace ubiquant
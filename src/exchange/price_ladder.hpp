@@ -0,0 +1,360 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "common/huge_page.hpp"
+#include "common/topology.hpp"
+#include "record.hpp"
+#include "record_slab.hpp"
+
+namespace ubiquant {
+
+/**
+ * @brief 价格档位的占用位图
+ *
+ * 每一位对应一个价格档位，置位表示该档位上有申报；
+ * `summary_` 的每一位对应 `words_` 中的一个 word，置位表示该 word 非零。
+ * 查找第一个非空档位只需要对两级 word 做 count-trailing-zeros。
+ */
+class LevelBitmap {
+private:
+    std::vector<uint64_t> words_;
+    std::vector<uint64_t> summary_;
+
+public:
+    void init(int num_levels) {
+        int num_words = (num_levels + 63) >> 6;
+        words_.assign(num_words, 0);
+        summary_.assign((num_words + 63) >> 6, 0);
+    }
+
+    void bindMemory(int node) const {
+        bind_memory(words_, node);
+        bind_memory(summary_, node);
+    }
+
+    inline void set(int idx) {
+        int w = idx >> 6;
+        words_[w] |= (1ull << (idx & 63));
+        summary_[w >> 6] |= (1ull << (w & 63));
+    }
+
+    inline void clear(int idx) {
+        int w = idx >> 6;
+        words_[w] &= ~(1ull << (idx & 63));
+        if (words_[w] == 0)
+            summary_[w >> 6] &= ~(1ull << (w & 63));
+    }
+
+    inline bool test(int idx) const {
+        return (words_[idx >> 6] >> (idx & 63)) & 1;
+    }
+
+    /* 返回 >= from 的第一个置位下标，不存在时返回 -1 */
+    int findFirst(int from) const {
+        int w = from >> 6;
+        if (w >= (int)words_.size())
+            return -1;
+
+        uint64_t bits = words_[w] & (~0ull << (from & 63));
+        if (bits)
+            return (w << 6) + __builtin_ctzll(bits);
+
+        /* 在 summary 中查找下一个非零 word */
+        int next = w + 1;
+        for (int s = next >> 6; s < (int)summary_.size(); s++) {
+            uint64_t sbits = summary_[s];
+            if (s == (next >> 6))
+                sbits &= (next & 63) ? (~0ull << (next & 63)) : ~0ull;
+            if (sbits) {
+                int nw = (s << 6) + __builtin_ctzll(sbits);
+                return (nw << 6) + __builtin_ctzll(words_[nw]);
+            }
+        }
+        return -1;
+    }
+};
+
+/**
+ * @brief 档位聚合量的树状数组（Fenwick tree）
+ *
+ * 下标为档位位置，支持 O(log L) 的单点增减、前缀和，以及按前缀和二分查找。
+ */
+class LevelFenwick {
+private:
+    std::vector<int64_t> tree_;
+    int n_ = 0;
+    int high_bit_ = 0;
+
+public:
+    void init(int n) {
+        n_ = n;
+        tree_.assign(n + 1, 0);
+        high_bit_ = 1;
+        while ((high_bit_ << 1) <= n_)
+            high_bit_ <<= 1;
+    }
+
+    void bindMemory(int node) const { bind_memory(tree_, node); }
+
+    inline void add(int pos, int64_t delta) {
+        for (int i = pos + 1; i <= n_; i += i & (-i))
+            tree_[i] += delta;
+    }
+
+    /* [0, pos] 的和，pos < 0 时为 0 */
+    inline int64_t prefixSum(int pos) const {
+        int64_t ret = 0;
+        for (int i = pos + 1; i > 0; i -= i & (-i))
+            ret += tree_[i];
+        return ret;
+    }
+
+    /* 前缀和 >= k 的最小位置（k > 0），不存在时返回 n */
+    int lowerBound(int64_t k) const {
+        int pos = 0;
+        for (int step = high_bit_; step > 0; step >>= 1) {
+            if (pos + step <= n_ && tree_[pos + step] < k) {
+                pos += step;
+                k -= tree_[pos];
+            }
+        }
+        return pos;
+    }
+};
+
+/**
+ * @brief 单个价格档位上的申报队列（FIFO，时间优先）
+ *
+ * 挂单节点来自 slab，档位只记录侵入式链表的首尾指针：
+ * 入队挂在队尾，出队摘下队首，撤单从中间摘除，均为 O(1)，且不会移动任何已有挂单。
+ */
+template <typename R>
+struct PriceLevel {
+    RecordNode<R>* head = nullptr;
+    RecordNode<R>* tail = nullptr;
+
+    inline bool empty() const { return head == nullptr; }
+
+    inline R* front() { return &head->rec; }
+
+    inline void push(RecordNode<R>* node) {
+        node->prev = tail;
+        node->next = nullptr;
+        if (tail == nullptr)
+            head = node;
+        else
+            tail->next = node;
+        tail = node;
+    }
+
+    inline RecordNode<R>* pop() {
+        RecordNode<R>* node = head;
+        unlink(node);
+        return node;
+    }
+
+    inline void unlink(RecordNode<R>* node) {
+        if (node->prev == nullptr)
+            head = node->next;
+        else
+            node->prev->next = node->next;
+        if (node->next == nullptr)
+            tail = node->prev;
+        else
+            node->next->prev = node->prev;
+    }
+};
+
+/**
+ * @brief 单边（买方或卖方）的价格档位数组
+ *
+ * 档位与涨跌停价格区间 [min_tick, max_tick] 内的 tick（0.01）一一对应。
+ * 位置 `pos` 按照优先级排序：卖方 pos = tick - min_tick（价低优先），
+ * 买方 pos = max_tick - tick（价高优先），因此两边的最优档位都是第一个置位。
+ *
+ * 同时按位置维护每个档位的剩余申报量与非空档位数的 Fenwick 树，
+ * 使得“对手方总量”、“前 K 档总量”、“优于等于某价格的总量”均为 O(log L)。
+ * 因此对队首申报的部分成交必须通过 `reduceFirst` 完成，以保持聚合量一致。
+ *
+ * 挂单本身存放在本方的 `RecordSlab` 中，地址稳定，成交完毕后节点归还 slab 复用。
+ * `insert` 返回挂单的 slot 编号，之后可以凭 slot 对任意挂单做撤单（`remove`）或减量（`reduce`）。
+ */
+template <typename R, bool HigherIsBetter>
+class PriceLadder {
+private:
+    price_t min_tick_;
+    price_t max_tick_;
+    int num_levels_;
+    /* 最优档位的位置，为 num_levels_ 时表示该方为空 */
+    int best_;
+
+    RecordSlab<R> slab_;
+    huge_vector<PriceLevel<R>> levels_;
+    LevelBitmap bitmap_;
+
+    /* 聚合量：每个档位的剩余申报量、非空档位计数、总量 */
+    LevelFenwick level_volume_;
+    LevelFenwick level_count_;
+    int64_t total_volume_ = 0;
+    int num_nonempty_ = 0;
+
+    inline int tickToPos(price_t tick) const {
+        assert(min_tick_ <= tick && tick <= max_tick_);
+        return HigherIsBetter ? (int)(max_tick_ - tick) : (int)(tick - min_tick_);
+    }
+
+    /* 档位清空时维护位图与非空档位计数；若为最优档位，向后查找新的最优档位 */
+    inline void levelEmptied(int pos) {
+        bitmap_.clear(pos);
+        level_count_.add(pos, -1);
+        num_nonempty_--;
+        if (pos == best_) {
+            int next = bitmap_.findFirst(best_ + 1);
+            best_ = (next == -1) ? num_levels_ : next;
+        }
+    }
+
+public:
+    PriceLadder(price_t lower_limit, price_t upper_limit)
+        : min_tick_(lower_limit), max_tick_(upper_limit) {
+        assert(min_tick_ <= max_tick_);
+        num_levels_ = (int)(max_tick_ - min_tick_ + 1);
+        best_ = num_levels_;
+        levels_.resize(num_levels_);
+        bitmap_.init(num_levels_);
+        level_volume_.init(num_levels_);
+        level_count_.init(num_levels_);
+    }
+
+    /* 把档位数组、位图与聚合量迁移到撮合线程所在的 NUMA 节点；slab 的 chunk 由撮合线程首次访问时分配 */
+    void bindMemory(int node) const {
+        bind_memory(levels_, node);
+        bitmap_.bindMemory(node);
+        level_volume_.bindMemory(node);
+        level_count_.bindMemory(node);
+    }
+
+    inline bool empty() const { return best_ == num_levels_; }
+
+    /* 挂单笔数 */
+    inline size_t size() const { return slab_.live(); }
+
+    /* 挂入对应档位的队尾，返回挂单的 slot 编号 */
+    uint32_t insert(const R& r) {
+        int pos = tickToPos(r.price);
+        PriceLevel<R>& level = levels_[pos];
+        if (level.empty()) {
+            bitmap_.set(pos);
+            level_count_.add(pos, 1);
+            num_nonempty_++;
+        }
+        RecordNode<R>* node = slab_.alloc(r);
+        level.push(node);
+        level_volume_.add(pos, r.volume);
+        total_volume_ += r.volume;
+        if (pos < best_)
+            best_ = pos;
+        return node->slot;
+    }
+
+    inline R* queryFirst() {
+        if (empty())
+            return nullptr;
+        return levels_[best_].front();
+    }
+
+    /* 队首申报部分成交 */
+    inline void reduceFirst(int volume) {
+        assert(!empty());
+        R* r = levels_[best_].front();
+        assert(volume < r->volume);
+        r->volume -= volume;
+        level_volume_.add(best_, -volume);
+        total_volume_ -= volume;
+    }
+
+    void removeFirst() {
+        assert(!empty());
+        PriceLevel<R>& level = levels_[best_];
+        int volume = level.front()->volume;
+        level_volume_.add(best_, -volume);
+        total_volume_ -= volume;
+        slab_.free(level.pop());
+        if (level.empty())
+            levelEmptied(best_);
+    }
+
+    inline R* at(uint32_t slot) {
+        return &slab_.at(slot)->rec;
+    }
+
+    /* 撤销任意一笔挂单，返回被撤销的剩余数量 */
+    int remove(uint32_t slot) {
+        RecordNode<R>* node = slab_.at(slot);
+        int pos = tickToPos(node->rec.price);
+        PriceLevel<R>& level = levels_[pos];
+        int volume = node->rec.volume;
+        level_volume_.add(pos, -volume);
+        total_volume_ -= volume;
+        level.unlink(node);
+        slab_.free(node);
+        if (level.empty())
+            levelEmptied(pos);
+        return volume;
+    }
+
+    /* 任意一笔挂单减量，保留其时间优先级 */
+    void reduce(uint32_t slot, int volume) {
+        RecordNode<R>* node = slab_.at(slot);
+        assert(0 < volume && volume < node->rec.volume);
+        node->rec.volume -= volume;
+        level_volume_.add(tickToPos(node->rec.price), -volume);
+        total_volume_ -= volume;
+    }
+
+    inline int64_t totalVolume() const {
+        return total_volume_;
+    }
+
+    /* 最优的 k 个非空档位（k 个不同价格）上的总量 */
+    int64_t volumeWithinLevels(int k) const {
+        if (k >= num_nonempty_)
+            return total_volume_;
+        if (k <= 0)
+            return 0;
+        return level_volume_.prefixSum(level_count_.lowerBound(k));
+    }
+
+    /* 价格优于或等于 price 的总量（卖方：<= price，买方：>= price） */
+    int64_t volumeAtOrBetter(price_t price) const {
+        int64_t pos = HigherIsBetter ? (max_tick_ - price) : (price - min_tick_);
+        if (pos < 0)
+            return 0;
+        if (pos >= num_levels_)
+            return total_volume_;
+        return level_volume_.prefixSum((int)pos);
+    }
+
+    /* 按照优先级（价格优先、时间优先）遍历所有挂单 */
+    template <typename F>
+    void forEach(F f) {
+        for (int pos = bitmap_.findFirst(0); pos != -1; pos = bitmap_.findFirst(pos + 1)) {
+            for (RecordNode<R>* node = levels_[pos].head; node != nullptr; node = node->next)
+                f(node->rec);
+        }
+    }
+
+    /* for debugging: 按照优先级输出 */
+    void print() {
+        int idx = 0;
+        forEach([&](R& r) {
+            printf("<%d>\t", idx++);
+            printRecord(r);
+        });
+    }
+};
+
+}  // namespace ubiquant
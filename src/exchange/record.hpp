@@ -1,8 +1,10 @@
 #pragma once
 
+#include "common/price.hpp"
+
 struct Record {
     int order_id;
-    double price;
+    ubiquant::price_t price;
     int volume;
 };
 
@@ -24,11 +26,11 @@ struct SellRecord : public Record {
 
 /* for debugging */
 static void printRecord(Record& r) {
-    printf("order_id:%d\tprice:%.2f\tvolume:%d\n", r.order_id, r.price, r.volume);
+    printf("order_id:%d\tprice:%.2f\tvolume:%d\n", r.order_id, ubiquant::price_to_double(r.price), r.volume);
 }
 
-template<typename T>
-void printRecordList(std::vector<T>& rv) {
+template<typename T, typename A>
+void printRecordList(std::vector<T, A>& rv) {
     for (int i = 0; i < rv.size(); ++i) {
         printf("<%d>\t", i);
         printRecord(rv[i]);
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ubiquant {
+
+/**
+ * @brief 集中申报簿中的一条挂单（侵入式链表节点）
+ *
+ * 节点由 `RecordSlab` 分配，地址在挂单存续期间保持不变，
+ * 同一价格档位上的挂单通过 `prev`/`next` 按时间先后串成 FIFO 双向链表，
+ * 因此可以在 O(1) 内从档位中间摘除（撤单）。
+ * `slot` 是节点在 slab 中的固定编号，供 order_id 索引使用。
+ */
+template <typename R>
+struct RecordNode {
+    R rec;
+    RecordNode* prev;
+    RecordNode* next;
+    uint32_t slot;
+};
+
+/**
+ * @brief 挂单节点的 slab 分配器
+ *
+ * 按块（`CHUNK_NODES` 个节点）向系统申请内存，块一经分配不再移动或释放；
+ * 成交完毕的节点挂回空闲链表，供之后的挂单复用。
+ * 因此稳态撮合（挂单数不再创新高）时不会产生任何内存分配。
+ */
+template <typename R>
+class RecordSlab {
+private:
+    constexpr static uint32_t CHUNK_SHIFT = 12;
+    constexpr static uint32_t CHUNK_NODES = 1u << CHUNK_SHIFT;
+
+    std::vector<std::unique_ptr<RecordNode<R>[]>> chunks_;
+    RecordNode<R>* free_ = nullptr;
+    size_t num_live_ = 0;
+
+    void grow() {
+        chunks_.emplace_back(new RecordNode<R>[CHUNK_NODES]);
+        RecordNode<R>* chunk = chunks_.back().get();
+        uint32_t base = (uint32_t)(chunks_.size() - 1) << CHUNK_SHIFT;
+        for (uint32_t i = CHUNK_NODES; i-- > 0;) {
+            chunk[i].slot = base + i;
+            chunk[i].next = free_;
+            free_ = &chunk[i];
+        }
+    }
+
+public:
+    RecordSlab() { grow(); }
+
+    RecordSlab(const RecordSlab&) = delete;
+    RecordSlab& operator=(const RecordSlab&) = delete;
+
+    inline RecordNode<R>* alloc(const R& r) {
+        if (free_ == nullptr)
+            grow();
+        RecordNode<R>* node = free_;
+        free_ = node->next;
+        node->rec = r;
+        node->prev = nullptr;
+        node->next = nullptr;
+        num_live_++;
+        return node;
+    }
+
+    inline void free(RecordNode<R>* node) {
+        assert(num_live_ > 0);
+        node->next = free_;
+        free_ = node;
+        num_live_--;
+    }
+
+    inline RecordNode<R>* at(uint32_t slot) {
+        assert(slot < capacity());
+        return &chunks_[slot >> CHUNK_SHIFT][slot & (CHUNK_NODES - 1)];
+    }
+
+    inline size_t live() const { return num_live_; }
+
+    inline size_t capacity() const { return chunks_.size() * CHUNK_NODES; }
+};
+
+}  // namespace ubiquant
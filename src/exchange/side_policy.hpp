@@ -0,0 +1,88 @@
+#pragma once
+
+#include "common/type.hpp"
+#include "record.hpp"
+
+namespace ubiquant {
+
+/**
+ * @brief 撮合内核的方向策略（编译期）
+ *
+ * 以新申报的方向区分：`BuySide` 为买入申报，与卖方队列成交；`SellSide` 为卖出申报，
+ * 与买方队列成交。两者提供相同的静态接口（本方/对手方申报簿访问、价格是否可成交、
+ * 成交记录中 bid_id/ask_id 的填写），撮合内核以其为模板参数实例化，
+ * 每个申报只在入口处按方向分派一次，循环内部不再有方向判断。
+ */
+struct BuySide {
+    using OwnRecord = BuyRecord;
+    using OppRecord = SellRecord;
+
+    /* 对手方（卖方）队列 */
+    template <typename Book>
+    static inline OppRecord* queryOpposite(Book& book) { return book.querySellFirst(); }
+
+    template <typename Book>
+    static inline void reduceOpposite(Book& book, int volume) { book.reduceSellFirst(volume); }
+
+    template <typename Book>
+    static inline void removeOpposite(Book& book) { book.removeSellFirst(); }
+
+    template <typename Book>
+    static inline int64_t oppositeTotalVolume(Book& book) { return book.totalSellVolume(); }
+
+    template <typename Book>
+    static inline int64_t oppositeVolumeWithinLevels(Book& book, int k) { return book.sellVolumeWithinLevels(k); }
+
+    /* 本方（买方）队列 */
+    template <typename Book>
+    static inline OwnRecord* queryOwn(Book& book) { return book.queryBuyFirst(); }
+
+    template <typename Book>
+    static inline void insertOwn(Book& book, OwnRecord& r) { book.insertBuyDecl(r); }
+
+    /* 买入申报可以与不高于申报价的卖单成交 */
+    static inline bool crosses(price_t order_price, price_t resting_price) { return resting_price <= order_price; }
+
+    static inline void assignIds(CommTrade& trade, int order_id, int resting_id) {
+        trade.bid_id = order_id;
+        trade.ask_id = resting_id;
+    }
+};
+
+struct SellSide {
+    using OwnRecord = SellRecord;
+    using OppRecord = BuyRecord;
+
+    /* 对手方（买方）队列 */
+    template <typename Book>
+    static inline OppRecord* queryOpposite(Book& book) { return book.queryBuyFirst(); }
+
+    template <typename Book>
+    static inline void reduceOpposite(Book& book, int volume) { book.reduceBuyFirst(volume); }
+
+    template <typename Book>
+    static inline void removeOpposite(Book& book) { book.removeBuyFirst(); }
+
+    template <typename Book>
+    static inline int64_t oppositeTotalVolume(Book& book) { return book.totalBuyVolume(); }
+
+    template <typename Book>
+    static inline int64_t oppositeVolumeWithinLevels(Book& book, int k) { return book.buyVolumeWithinLevels(k); }
+
+    /* 本方（卖方）队列 */
+    template <typename Book>
+    static inline OwnRecord* queryOwn(Book& book) { return book.querySellFirst(); }
+
+    template <typename Book>
+    static inline void insertOwn(Book& book, OwnRecord& r) { book.insertSellDecl(r); }
+
+    /* 卖出申报可以与不低于申报价的买单成交 */
+    static inline bool crosses(price_t order_price, price_t resting_price) { return resting_price >= order_price; }
+
+    static inline void assignIds(CommTrade& trade, int order_id, int resting_id) {
+        trade.bid_id = resting_id;
+        trade.ask_id = order_id;
+    }
+};
+
+}  // namespace ubiquant
@@ -0,0 +1,214 @@
+#include "snapshot_writer.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+namespace ubiquant {
+
+namespace {
+
+// rewrite the journal file open as fd without its leading records up to the first one not dropped,
+// return the fd of the rewritten file (fd itself when nothing is dropped)
+template <typename T, typename Pred>
+int compact_file(int fd, const std::string& path, Pred dropped) {
+    off_t size = lseek(fd, 0, SEEK_END);
+    std::vector<T> records(size / sizeof(T));
+    if (pread(fd, records.data(), records.size() * sizeof(T), 0) != (ssize_t)(records.size() * sizeof(T)))
+        throw std::runtime_error("read journal file error.");
+    size_t first = std::partition_point(records.begin(), records.end(), dropped) - records.begin();
+    if (first == 0)
+        return fd;
+
+    // tmp file then rename, as BookSnapshot::dump, the journal on disk is always whole
+    std::string tmp_path = path + ".tmp";
+    int tmp_fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0640);
+    if (tmp_fd == -1
+        || !BookSnapshot::writeAll(tmp_fd, records.data() + first, (records.size() - first) * sizeof(T))
+        || fdatasync(tmp_fd) != 0
+        || rename(tmp_path.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("compact journal file error.");
+    close(fd);
+    return tmp_fd;
+}
+
+}  // namespace
+
+ExchangeSnapshotWriter::ExchangeSnapshotWriter()
+    : journals_(Config::stock_num + 1), events_(3 * (Config::stock_num + 1)) {
+    if (!enabled())
+        return;
+
+    ASSERT_MSG(!Config::snapshot_folder.empty(), "snapshot_folder must be set when snapshot_interval > 0");
+
+    // NOTICE: stock code starts from 1
+    for (int code = 1; code <= Config::stock_num; code++) {
+        if (code % Config::exchange_num != Config::partition_idx)
+            continue;
+
+        // keep the journal of the crashed run when recovering from it
+        int flags = O_RDWR | O_CREAT | O_APPEND | (Config::snapshot_recover ? 0 : O_TRUNC);
+        journals_[code].reset(new StockJournal());
+        journal_fds_[code] = open(BookSnapshot::journal_fname(code).c_str(), flags, 0640);
+        trades_fds_[code] = open(BookSnapshot::trades_fname(code).c_str(), flags, 0640);
+        if (journal_fds_[code] == EMPTY_FD || trades_fds_[code] == EMPTY_FD)
+            throw std::runtime_error("open journal file error.");
+    }
+}
+
+ExchangeSnapshotWriter::~ExchangeSnapshotWriter() {
+    for (auto [stk_code, fd] : journal_fds_) {
+        if (fd != EMPTY_FD) close(fd);
+    }
+    for (auto [stk_code, fd] : trades_fds_) {
+        if (fd != EMPTY_FD) close(fd);
+    }
+}
+
+void ExchangeSnapshotWriter::run() {
+    events_.bind_memory(pin_thread("snapshot_writer"));
+    logstream(LOG_EMPH) << "Exchange SnapshotWriter is running..." << LOG_endl;
+    while (true) {
+        events_.take([this](const Event& event) {
+            if (event.snapshot == nullptr) {
+                journals_[event.stk_code]->dirty.exchange(false, std::memory_order_acq_rel);
+                flush_journal(event.stk_code);
+                return;
+            }
+
+            // the journal up to the snapshot point goes to disk first
+            BookSnapshot* snapshot = event.snapshot;
+            flush_journal(snapshot->stk_code);
+            if (!snapshot->dump(BookSnapshot::fname(snapshot->stk_code))) {
+                logstream(LOG_ERROR) << "dump snapshot of stock " << snapshot->stk_code << " failed" << LOG_endl;
+            } else {
+                // keep the trades after the previous snapshot point, a recovery replays them
+                int& order_id = snapshot_order_ids_[snapshot->stk_code];
+                compact_journal(snapshot->stk_code, order_id);
+                order_id = snapshot->last_commit_order_id;
+            }
+            snapshot->in_flight.store(false, std::memory_order_release);
+        }, EVENT_BATCH, WAIT_TIME);
+    }
+}
+
+void ExchangeSnapshotWriter::flush_journal(int stk_code) {
+    StockJournal& journal = *journals_[stk_code];
+    // order ids before trades, see StockJournal
+    uint64_t ids_tail = journal.ids_tail.load(std::memory_order_acquire);
+    uint64_t trades_tail = journal.trades_tail.load(std::memory_order_acquire);
+
+    // [head, tail) of a ring, in at most two writes
+    auto write_ring = [](int fd, const auto* ring, uint64_t capacity, uint64_t head, uint64_t tail) {
+        using R = std::remove_cv_t<std::remove_pointer_t<decltype(ring)>>;
+        while (head != tail) {
+            uint64_t n = std::min(tail - head, capacity - (head & (capacity - 1)));
+            if (!BookSnapshot::writeAll(fd, ring + (head & (capacity - 1)), n * sizeof(R)))
+                return false;
+            head += n;
+        }
+        return true;
+    };
+
+    // trades first, so a journaled order id always has its trades on disk
+    uint64_t trades_head = journal.trades_head.load(std::memory_order_relaxed);
+    if (!write_ring(trades_fds_[stk_code], journal.trades.get(), JOURNAL_TRADES, trades_head, trades_tail))
+        throw std::runtime_error("write trades journal file error.");
+    journal.trades_head.store(trades_tail, std::memory_order_release);
+
+    uint64_t ids_head = journal.ids_head.load(std::memory_order_relaxed);
+    if (!write_ring(journal_fds_[stk_code], journal.order_ids.get(), JOURNAL_ORDER_IDS, ids_head, ids_tail))
+        throw std::runtime_error("write journal file error.");
+    journal.ids_head.store(ids_tail, std::memory_order_release);
+}
+
+void ExchangeSnapshotWriter::compact_journal(int stk_code, int order_id) {
+    // both files are ordered by order id, as in truncate_journal
+    trades_fds_[stk_code] = compact_file<CommTrade>(trades_fds_[stk_code], BookSnapshot::trades_fname(stk_code),
+                                                    [&](const CommTrade& trade) {
+        return std::max(trade.bid_id, trade.ask_id) <= order_id;
+    });
+    journal_fds_[stk_code] = compact_file<int>(journal_fds_[stk_code], BookSnapshot::journal_fname(stk_code),
+                                               [&](int id) { return id <= order_id; });
+}
+
+void ExchangeSnapshotWriter::notify_journal(int stk_code) {
+    if (!journals_[stk_code]->dirty.exchange(true, std::memory_order_acq_rel))
+        events_.put(Event{stk_code, nullptr});
+}
+
+void ExchangeSnapshotWriter::put_journal(int stk_code, int last_commit_order_id, const std::vector<CommTrade>& trades) {
+    StockJournal& journal = *journals_[stk_code];
+
+    // trades first, see StockJournal; wait (rarely) while the writer is a whole buffer behind
+    uint64_t tail = journal.trades_tail.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < trades.size();) {
+        uint64_t room = JOURNAL_TRADES - (tail - journal.trades_head.load(std::memory_order_acquire));
+        if (room == 0) {
+            notify_journal(stk_code);
+            std::this_thread::yield();
+            continue;
+        }
+        uint64_t n = std::min<uint64_t>(room, trades.size() - i);
+        for (uint64_t k = 0; k < n; k++) {
+            journal.trades[(tail + k) & (JOURNAL_TRADES - 1)] = trades[i + k];
+        }
+        tail += n;
+        i += n;
+        journal.trades_tail.store(tail, std::memory_order_release);
+    }
+
+    uint64_t ids_tail = journal.ids_tail.load(std::memory_order_relaxed);
+    while (ids_tail - journal.ids_head.load(std::memory_order_acquire) == JOURNAL_ORDER_IDS) {
+        notify_journal(stk_code);
+        std::this_thread::yield();
+    }
+    journal.order_ids[ids_tail & (JOURNAL_ORDER_IDS - 1)] = last_commit_order_id;
+    journal.ids_tail.store(ids_tail + 1, std::memory_order_release);
+
+    notify_journal(stk_code);
+}
+
+int ExchangeSnapshotWriter::truncate_journal(int stk_code, int last_commit_order_id) {
+    // committed order ids are increasing, keep the prefix up to the snapshot point
+    int crashed_order_id = 0;
+    std::vector<int> order_ids;
+    int fd = open(BookSnapshot::journal_fname(stk_code).c_str(), O_RDWR);
+    if (fd != EMPTY_FD) {
+        off_t size = lseek(fd, 0, SEEK_END);
+        order_ids.resize(size / sizeof(int));
+        if (pread(fd, order_ids.data(), order_ids.size() * sizeof(int), 0) != (ssize_t)(order_ids.size() * sizeof(int)))
+            throw std::runtime_error("read journal file error.");
+        if (!order_ids.empty())
+            crashed_order_id = order_ids.back();
+        size_t keep = std::upper_bound(order_ids.begin(), order_ids.end(), last_commit_order_id) - order_ids.begin();
+        if (ftruncate(fd, keep * sizeof(int)) != 0)
+            throw std::runtime_error("truncate journal file error.");
+        close(fd);
+    }
+
+    // trades are ordered by the incoming order id (the larger of bid_id / ask_id)
+    fd = open(BookSnapshot::trades_fname(stk_code).c_str(), O_RDWR);
+    if (fd != EMPTY_FD) {
+        off_t size = lseek(fd, 0, SEEK_END);
+        std::vector<CommTrade> trades(size / sizeof(CommTrade));
+        if (pread(fd, trades.data(), trades.size() * sizeof(CommTrade), 0) != (ssize_t)(trades.size() * sizeof(CommTrade)))
+            throw std::runtime_error("read trades journal file error.");
+        size_t keep = std::partition_point(trades.begin(), trades.end(), [&](const CommTrade& trade) {
+            return std::max(trade.bid_id, trade.ask_id) <= last_commit_order_id;
+        }) - trades.begin();
+        if (ftruncate(fd, keep * sizeof(CommTrade)) != 0)
+            throw std::runtime_error("truncate trades journal file error.");
+        close(fd);
+    }
+
+    return crashed_order_id;
+}
+
+void ExchangeSnapshotWriter::put_snapshot(BookSnapshot* snapshot) {
+    snapshot->in_flight.store(true, std::memory_order_release);
+    events_.put(Event{snapshot->stk_code, snapshot});
+}
+
+}  // namespace ubiquant
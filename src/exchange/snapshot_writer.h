@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+
+#include "common/mpsc_ring.hpp"
+#include "common/thread.h"
+#include "common/topology.hpp"
+#include "common/type.hpp"
+#include "book_snapshot.hpp"
+
+namespace ubiquant {
+
+/**
+ * @brief 申报簿快照与 commit journal 的后台写盘线程
+ *
+ * StockExchange 只负责把申报簿复制到空闲的快照缓冲区（双缓冲），
+ * 写文件、fdatasync 都在这个线程完成，不占用撮合线程。
+ * journal 为每只股票两个文件：`journal.<stk>` 依次追加每批 commit 之后的 last_commit_order_id，
+ * `trades.<stk>` 追加这一批产生的成交（CommTrade）。
+ * 撮合线程只把 journal 追加到该股票预先分配的环形缓冲区（无锁、不分配内存），
+ * 只有写盘线程落后整个缓冲区时才需要等待。
+ *
+ * 成交是异步发送的，快照时刻之前的成交未必已经到达 trader（进程被杀时仍在发送队列中），
+ * 因此恢复时除了让 trader 从快照点重发 order，还要把快照点之前的成交重放一遍，
+ * trader 按 order_id 丢弃已经收到过的部分。
+ * 每写完一个快照，journal 只保留上一个快照点之后的部分（compact_journal），
+ * 恢复时重放的是最近一个快照周期的成交，文件大小不随全天的成交量增长。
+ */
+class ExchangeSnapshotWriter : public ubi_thread {
+public:
+    ExchangeSnapshotWriter();
+    ~ExchangeSnapshotWriter();
+
+    void run() override;
+
+    inline bool enabled() const { return Config::snapshot_interval > 0; }
+
+    // Stock exchange will call this function
+    void put_journal(int stk_code, int last_commit_order_id, const std::vector<CommTrade>& trades);
+
+    // Stock exchange will call this function
+    void put_snapshot(BookSnapshot* snapshot);
+
+    // Recovery: drop journal entries after the snapshot point, return the last order id committed by the crashed run
+    static int truncate_journal(int stk_code, int last_commit_order_id);
+
+    // Recovery: visit the journaled trades (already truncated to the snapshot point) chunk by chunk,
+    // those after the previous snapshot point (see compact_journal)
+    template <typename F>
+    static void replay_trades(int stk_code, F f) {
+        constexpr size_t REPLAY_CHUNK = 4096;
+        int fd = open(BookSnapshot::trades_fname(stk_code).c_str(), O_RDONLY);
+        if (fd == -1)
+            return;
+        std::vector<CommTrade> trades(REPLAY_CHUNK);
+        ssize_t n;
+        while ((n = read(fd, trades.data(), REPLAY_CHUNK * sizeof(CommTrade))) > 0) {
+            trades.resize(n / sizeof(CommTrade));
+            f(trades);
+            trades.resize(REPLAY_CHUNK);
+        }
+        close(fd);
+    }
+
+protected:
+    constexpr static int EMPTY_FD = -1;
+    constexpr static size_t EVENT_BATCH = 64;
+    constexpr static std::chrono::microseconds WAIT_TIME{100000};
+
+    /* 每只股票 journal 缓冲区的容量（记录数，2 的幂） */
+    constexpr static uint64_t JOURNAL_TRADES = 1 << 16;
+    constexpr static uint64_t JOURNAL_ORDER_IDS = 1 << 12;
+
+    /**
+     * 单只股票的 journal 缓冲区：同一时刻只有一个撮合线程追加，写盘线程取走（单生产者单消费者）。
+     * 先追加成交再追加 order id，写盘线程先读 order id 的 tail，
+     * 因此取到的每个 order id 的成交都已经在缓冲区中。
+     */
+    struct StockJournal {
+        std::unique_ptr<CommTrade[]> trades{new CommTrade[JOURNAL_TRADES]};
+        std::unique_ptr<int[]> order_ids{new int[JOURNAL_ORDER_IDS]};
+        alignas(64) std::atomic<uint64_t> trades_tail{0};
+        std::atomic<uint64_t> ids_tail{0};
+        alignas(64) std::atomic<uint64_t> trades_head{0};
+        std::atomic<uint64_t> ids_head{0};
+        /* 该股票已经在 events_ 中排队 */
+        std::atomic<bool> dirty{false};
+    };
+
+    /* 写盘线程的事件：snapshot 为 nullptr 表示该股票的 journal 有新内容 */
+    struct Event {
+        int stk_code;
+        BookSnapshot* snapshot;
+    };
+
+    // queue the stock for the writer, at most once until the writer takes it
+    void notify_journal(int stk_code);
+    void flush_journal(int stk_code);
+    // drop the journal entries up to order_id, once a later snapshot is on disk
+    void compact_journal(int stk_code, int order_id);
+
+    // by stk_code, only the stocks of this exchange
+    std::vector<std::unique_ptr<StockJournal>> journals_;
+    // each stock is queued at most once for its journal and twice for its snapshots (double buffering)
+    MpscRing<Event> events_;
+
+    std::unordered_map<int, int> journal_fds_;
+    std::unordered_map<int, int> trades_fds_;
+    // last_commit_order_id of the latest snapshot on disk, the journals keep what comes after the one before
+    std::unordered_map<int, int> snapshot_order_ids_;
+};
+
+}  // namespace ubiquant
@@ -3,6 +3,8 @@
 #include <iostream>
 #include <algorithm>
 
+#include "common/huge_page.hpp"
+#include "common/topology.hpp"
 #include "debug.hpp"
 #include "record.hpp"
 
@@ -18,14 +20,45 @@ class StockDeclarationBook {
  *
  */
 private:
-    std::vector<BuyRecord> buy_decls;
-    std::vector<SellRecord> sell_decls;
+    ubiquant::huge_vector<BuyRecord> buy_decls;
+    ubiquant::huge_vector<SellRecord> sell_decls;
+
+    template <typename R>
+    static Record* findDecl(ubiquant::huge_vector<R>& decls, int order_id) {
+        for (auto& r: decls)
+            if (r.order_id == order_id)
+                return &r;
+        return nullptr;
+    }
+
+    template <typename R>
+    static int eraseDecl(ubiquant::huge_vector<R>& decls, int order_id) {
+        for (size_t i = 0; i < decls.size(); i++) {
+            if (decls[i].order_id == order_id) {
+                int volume = decls[i].volume;
+                decls.erase(decls.begin() + i);
+                std::make_heap(decls.begin(), decls.end());
+                return volume;
+            }
+        }
+        return -1;
+    }
+
 public:
     StockDeclarationBook () {
         buy_decls.reserve(0x2000);
         sell_decls.reserve(0x2000);
     };
 
+    /* 与 StockLadderBook 保持相同的构造接口，涨跌停价格在堆实现中不需要 */
+    StockDeclarationBook (ubiquant::price_t lower_limit, ubiquant::price_t upper_limit) : StockDeclarationBook() {};
+
+    /* 堆只预留了容量，迁移预留的部分即可 */
+    void bindMemory(int node) const {
+        ubiquant::bind_memory(buy_decls.data(), buy_decls.capacity() * sizeof(BuyRecord), node);
+        ubiquant::bind_memory(sell_decls.data(), sell_decls.capacity() * sizeof(SellRecord), node);
+    }
+
     void print() {
         std::cout << "BuyDecls:" << std::endl;
         printRecordList(buy_decls);
@@ -53,6 +86,11 @@ public:
         return &buy_decls[0];
     }
 
+    void reduceBuyFirst(int volume) {
+        assert(!buy_decls.empty());
+        buy_decls[0].volume -= volume;
+    }
+
     void removeBuyFirst() {
         assert(!buy_decls.empty());
         std::pop_heap(buy_decls.begin(), buy_decls.end());
@@ -65,23 +103,110 @@ public:
         return &sell_decls[0];
     }
 
+    void reduceSellFirst(int volume) {
+        assert(!sell_decls.empty());
+        sell_decls[0].volume -= volume;
+    }
+
     void removeSellFirst() {
         assert(!sell_decls.empty());
         std::pop_heap(sell_decls.begin(), sell_decls.end());
         sell_decls.pop_back();
     }
 
-    int totalBuyVolume() {
-        int ret = 0;
+    /* 线性查找并撤销挂单，返回被撤销的剩余数量；申报不在申报簿中时返回 -1 */
+    int cancelDecl(int order_id) {
+        int ret = eraseDecl(buy_decls, order_id);
+        if (ret == -1)
+            ret = eraseDecl(sell_decls, order_id);
+        return ret;
+    }
+
+    /* 线性查找并减量，减至 0 时等同于撤单；申报不在申报簿中时返回 -1 */
+    int reduceDecl(int order_id, int volume) {
+        assert(volume > 0);
+        Record* r = findDecl(buy_decls, order_id);
+        if (r == nullptr)
+            r = findDecl(sell_decls, order_id);
+        if (r == nullptr)
+            return -1;
+        if (volume >= r->volume) {
+            cancelDecl(order_id);
+            return 0;
+        }
+        r->volume -= volume;
+        return 0;
+    }
+
+    inline size_t numBuyDecls() const { return buy_decls.size(); }
+    inline size_t numSellDecls() const { return sell_decls.size(); }
+
+    /* 按照优先级遍历挂单（先复制再排序，不破坏堆），用于 snapshot */
+    template <typename F>
+    void forEachBuyDecl(F f) {
+        std::vector<BuyRecord> decls(buy_decls.begin(), buy_decls.end());
+        std::sort(decls.begin(), decls.end(), [](BuyRecord& a, BuyRecord& b) { return b < a; });
+        for (auto& br: decls)
+            f(br);
+    }
+
+    template <typename F>
+    void forEachSellDecl(F f) {
+        std::vector<SellRecord> decls(sell_decls.begin(), sell_decls.end());
+        std::sort(decls.begin(), decls.end(), [](SellRecord& a, SellRecord& b) { return b < a; });
+        for (auto& sr: decls)
+            f(sr);
+    }
+
+    int64_t totalBuyVolume() {
+        int64_t ret = 0;
         for (auto& br: buy_decls)
             ret += br.volume;
         return ret;
     }
 
-    int totalSellVolume() {
-        int ret = 0;
+    int64_t totalSellVolume() {
+        int64_t ret = 0;
         for (auto& sr: sell_decls)
             ret += sr.volume;
         return ret;
     }
+
+    int64_t buyVolumeWithinLevels(int k) {
+        std::vector<ubiquant::price_t> prices;
+        for (auto& br: buy_decls)
+            prices.push_back(br.price);
+        std::sort(prices.begin(), prices.end(), std::greater<ubiquant::price_t>());
+        prices.erase(std::unique(prices.begin(), prices.end()), prices.end());
+        if (k <= 0 || prices.empty())
+            return 0;
+        return buyVolumeAtOrBetter(prices[std::min<size_t>(k, prices.size()) - 1]);
+    }
+
+    int64_t sellVolumeWithinLevels(int k) {
+        std::vector<ubiquant::price_t> prices;
+        for (auto& sr: sell_decls)
+            prices.push_back(sr.price);
+        std::sort(prices.begin(), prices.end());
+        prices.erase(std::unique(prices.begin(), prices.end()), prices.end());
+        if (k <= 0 || prices.empty())
+            return 0;
+        return sellVolumeAtOrBetter(prices[std::min<size_t>(k, prices.size()) - 1]);
+    }
+
+    int64_t buyVolumeAtOrBetter(ubiquant::price_t price) {
+        int64_t ret = 0;
+        for (auto& br: buy_decls)
+            if (br.price >= price)
+                ret += br.volume;
+        return ret;
+    }
+
+    int64_t sellVolumeAtOrBetter(ubiquant::price_t price) {
+        int64_t ret = 0;
+        for (auto& sr: sell_decls)
+            if (sr.price <= price)
+                ret += sr.volume;
+        return ret;
+    }
 };
\ No newline at end of file
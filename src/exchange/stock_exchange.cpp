@@ -2,657 +2,332 @@
 
 namespace ubiquant {
 
-StockExchange::StockExchange(int stk_code) : stk_code(stk_code), last_commit_order_id(0) {}
-
-void StockExchange::run() {
-    logstream(LOG_EMPH) << "Exchange StockExchange [" << stk_code << "] is running..." << LOG_endl;
-    while(true) {
-        std::vector<Order> orders = comsumeOrder();
-        for(auto& order : orders) {
-            receiveOrder(order);
+StockExchange::StockExchange(int stk_code, price_t lower_limit, price_t upper_limit)
+    : stk_code(stk_code), decl_book(lower_limit, upper_limit), last_commit_order_id(0) {
+    trade_batch.reserve(TRADE_BATCH_RESERVE);
+    next_snapshot_order_id = Config::snapshot_interval;
+}
+
+void StockExchange::bindMemory(int node) const {
+    decl_book.bindMemory(node);
+    bind_memory(trade_batch.data(), trade_batch.capacity() * sizeof(CommTrade), node);
+}
+
+size_t StockExchange::process() {
+    size_t cnt = comsumeOrder();
+    if (cnt == 0)
+        return 0;
+
+    auto snapshot_writer = Global<ExchangeSnapshotWriter>::Get();
+    bool snapshot_enabled = snapshot_writer != nullptr && snapshot_writer->enabled();
+    if (snapshot_enabled)
+        snapshot_writer->put_journal(stk_code, last_commit_order_id, trade_batch);
+
+    // all fills of one drained batch are handed off at once (split between orders, see ExchangeTradeSender)
+    flushTrades();
+    Global<Exchange>::Get()->ackOrder(stk_code, last_commit_order_id);
+
+    if (snapshot_enabled && last_commit_order_id >= next_snapshot_order_id)
+        takeSnapshot();
+    return cnt;
+}
+
+void StockExchange::takeSnapshot() {
+    // double buffering: skip this round if both buffers are still being written
+    BookSnapshot* snapshot = nullptr;
+    for (auto& buf : snapshots) {
+        if (!buf.in_flight.load(std::memory_order_acquire)) {
+            snapshot = &buf;
+            break;
         }
     }
+    if (snapshot == nullptr)
+        return;
+
+    snapshot->stk_code = stk_code;
+    snapshot->last_commit_order_id = last_commit_order_id;
+    snapshot->buy_decls.clear();
+    snapshot->sell_decls.clear();
+    // the copy stays on the matching thread, reserve so that it never reallocates midway
+    snapshot->buy_decls.reserve(decl_book.numBuyDecls());
+    snapshot->sell_decls.reserve(decl_book.numSellDecls());
+    decl_book.forEachBuyDecl([&](Record& r) { snapshot->buy_decls.push_back(r); });
+    decl_book.forEachSellDecl([&](Record& r) { snapshot->sell_decls.push_back(r); });
+    Global<ExchangeSnapshotWriter>::Get()->put_snapshot(snapshot);
+
+    next_snapshot_order_id = last_commit_order_id + Config::snapshot_interval;
 }
 
-std::vector<Order> StockExchange::comsumeOrder() {
-    return Global<Exchange>::Get()->comsumeOrder(stk_code);
+void StockExchange::restoreSnapshot(const BookSnapshot& snapshot) {
+    assert(snapshot.stk_code == stk_code);
+    for (auto& r : snapshot.buy_decls) {
+        BuyRecord br = {r.order_id, r.price, r.volume};
+        decl_book.insertBuyDecl(br);
+    }
+    for (auto& r : snapshot.sell_decls) {
+        SellRecord sr = {r.order_id, r.price, r.volume};
+        decl_book.insertSellDecl(sr);
+    }
+    last_commit_order_id = snapshot.last_commit_order_id;
+    next_snapshot_order_id = last_commit_order_id + Config::snapshot_interval;
 }
 
-void StockExchange::produceTrade(Trade& new_trade) {
+size_t StockExchange::comsumeOrder() {
+    // orders are already in order_id sequence in the window, commit them in place
+    return order_window->drain([this](const Order& order) {
+        receiveOrder(order);
+    });
+}
+
+void StockExchange::produceTrade(CommTrade& new_trade) {
     // version1: local vector storage
     // trade_list.push_back(new_trade);
 
     // version2: call Exchange to push into global msg queue
-    Global<Exchange>::Get()->produceTrade(new_trade);
+    // Global<Exchange>::Get()->produceTrade(new_trade);
+
+    // version3: buffer locally, and hand off the whole batch in flushTrades()
+    trade_batch.push_back(new_trade);
+}
+
+void StockExchange::flushTrades() {
+    if (trade_batch.empty())
+        return;
+    Global<Exchange>::Get()->produceTrades(trade_batch);
+    trade_batch.clear();
 }
 
-int StockExchange::receiveOrder(Order& order) {
+int StockExchange::receiveOrder(const Order& order) {
     /* sanity check */
     assert(order.stk_code == stk_code);
+    /* orders arrive in order_id sequence (see Exchange::order_buffer) */
+    assert(order.order_id == last_commit_order_id + 1);
 
-    int ret = 0;
+    /* Handle single order */
+    int ret = commitOrder(order);
+    if (ret != 0) {
+        ex_debug("[%d] status ret=%d\n", last_commit_order_id + 1, ret);
+    }
 
-    /**
-     * 1. push it into `not_ready_orders`
-     * 2. pop and handle not_ready_orders until the head is not `last_commit_order_id + 1`
-     */
+    /* Increase last_commit_id */
+    last_commit_order_id++;
 
-    /* `not_ready_orders` should maintain as heap */
-    /* TODO: should maintain as a sliding window */
-    not_ready_orders.push_back(order);
-    std::push_heap(not_ready_orders.begin(), not_ready_orders.end(), orderGtById);
+    return ret;
+}
 
-    while (true) {
-        if (not_ready_orders.empty())
-            break;
-        if (last_commit_order_id + 1 != not_ready_orders[0].order_id)
+/* 与对手方队首依次成交，直到成交完 volume 或 stop(对手方队首) 为真，返回未成交的数量 */
+template <typename Side, typename Stop>
+inline int StockExchange::matchOpposite(const Order& order, int volume, Stop stop)
+{
+    while (volume) {
+        typename Side::OppRecord *r = Side::queryOpposite(decl_book);
+        if (r == nullptr || stop(r))
             break;
 
-        /* Handle single order */
-        ret = commitOrder(not_ready_orders[0]);
-        if (ret != 0) {
-            ex_debug("[%d] status ret=%d\n", last_commit_order_id + 1, ret);
+        CommTrade new_trade;
+        new_trade.stk_code = stk_code;
+        Side::assignIds(new_trade, order.order_id, r->order_id);
+        new_trade.price = r->price;
+
+        if (volume < r->volume) {
+            /* 当前申报可以完全处理，对手方队首还有剩余 */
+            new_trade.volume = volume;
+            produceTrade(new_trade);
+
+            Side::reduceOpposite(decl_book, volume);
+            volume = 0;
+        } else {
+            /* 对手方队首将被完全处理，当前申报继续 */
+            new_trade.volume = r->volume;
+            produceTrade(new_trade);
+
+            volume -= r->volume;
+            Side::removeOpposite(decl_book);
         }
-
-        /* Erase commited order */
-        std::pop_heap(not_ready_orders.begin(), not_ready_orders.end(), orderGtById);
-        not_ready_orders.pop_back();
-
-        /* Increase last_commit_id */
-        last_commit_order_id++;
     }
-
-    return ret;
+    return volume;
 }
 
+/* 对手方队首一定存在，成交不受价格限制 */
+struct NoStop {
+    template <typename R>
+    inline bool operator()(R*) const { return false; }
+};
+
 /* Type 0 */
-int StockExchange::handleLimitOrder(Order& order)
+template <typename Side>
+int StockExchange::handleLimitOrder(const Order& order)
 {
-    int left_volume = order.volume;
-    if (order.direction == 1) {
-        /* Buy in */
-        /* 依次匹配申报簿卖方的序列，直到卖一无法与当前申报成交 */
-        while (true) {
-            if (left_volume == 0)
-                break;
-            SellRecord *sr = decl_book.querySellFirst();
-            if (sr == nullptr)
-                break;
-            if (sr->price > order.price)
-                break;
-
-            if (left_volume < sr->volume) {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     order.order_id,
-                    ask_id:     sr->order_id,
-                    price:      sr->price,
-                    volume:     left_volume,
-                };
-                produceTrade(new_trade);
-
-                sr->volume -= left_volume;
-                left_volume -= left_volume;
-            } else {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     order.order_id,
-                    ask_id:     sr->order_id,
-                    price:      sr->price,
-                    volume:     sr->volume,
-                };
-                produceTrade(new_trade);
-
-                left_volume -= sr->volume,
-                decl_book.removeSellFirst();
-            }
-        }
-
-        if (left_volume != 0) {
-            BuyRecord new_br = {
-                order.order_id,
-                order.price,
-                left_volume
-            };
-            decl_book.insertBuyDecl(new_br);
-        }
-    } else if (order.direction == -1) {
-        /* Sell out */
-        /* 类似的，依次和买一成交 */
-        while (true) {
-            if (left_volume == 0)
-                break;
-            BuyRecord *br = decl_book.queryBuyFirst();
-            if (br == nullptr)
-                break;
-            if (br->price < order.price)
-                break;
-
-            if (left_volume < br->volume) {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     br->order_id,
-                    ask_id:     order.order_id,
-                    price:      br->price,
-                    volume:     left_volume,
-                };
-                produceTrade(new_trade);
-
-                br->volume -= left_volume;
-                left_volume -= left_volume;
-            } else {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     br->order_id,
-                    ask_id:     order.order_id,
-                    price:      br->price,
-                    volume:     br->volume,
-                };
-                produceTrade(new_trade);
-
-                left_volume -= br->volume;
-                decl_book.removeBuyFirst();
-            }
-        }
+    /* 依次匹配对手方的序列，直到对手方第一无法与当前申报成交 */
+    int left_volume = matchOpposite<Side>(order, order.volume, [&](typename Side::OppRecord* opp) {
+        return !Side::crosses(order.price, opp->price);
+    });
 
-        if (left_volume != 0) {
-            SellRecord new_sr = {
-                order.order_id,
-                order.price,
-                left_volume
-            };
-            decl_book.insertSellDecl(new_sr);
-        }
-    } else {
-        ex_debug("strange order direction: %d\n", order.direction);
+    if (left_volume != 0) {
+        typename Side::OwnRecord new_r = {
+            order.order_id,
+            order.price,
+            left_volume
+        };
+        Side::insertOwn(decl_book, new_r);
     }
 
     return 0;
 }
 
 /* Type 1 */
-int StockExchange::handleCounterpartyBest(Order& order)
+template <typename Side>
+int StockExchange::handleCounterpartyBest(const Order& order)
 {
     /* 以申报进入交易主机时集中申报簿中对手方队列的最优价格为其申报价格。*/
-    if (order.direction == 1) {
-        /* Buy in */
-        SellRecord* sr = decl_book.querySellFirst();
+    typename Side::OppRecord* r = Side::queryOpposite(decl_book);
 
-        /* 集中申报簿中，对手方（卖方）无申报：直接撤回此申报 */
-        if (sr == nullptr)
-            return -1;
-
-        double t_price = sr->price;
-        int left_volume = order.volume;
-
-        /* NOTE: 可能需要比对多组价格相同的 SellRecord */
-        while (left_volume) {
-            if (left_volume < sr->volume) {
-                /* 当前申报可以完全处理，卖一还有剩余 */
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     order.order_id,
-                    ask_id:     sr->order_id,
-                    price:      t_price,
-                    volume:     left_volume,
-                };
-                produceTrade(new_trade);
-
-                sr->volume -= left_volume;
-                left_volume -= left_volume;
-            } else {
-                /* 卖一将被完全处理，当前申报继续 */
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     order.order_id,
-                    ask_id:     sr->order_id,
-                    price:      t_price,
-                    volume:     sr->volume,
-                };
-                produceTrade(new_trade);
-
-                left_volume -= sr->volume;
-                decl_book.removeSellFirst();
-
-                if (left_volume == 0)
-                    break;
-
-                sr = decl_book.querySellFirst();
-                if (sr == nullptr || sr->price != t_price) {
-                    /* 卖一价格不足交易，将剩余部分以限价形式记录在集中申报簿中 */
-                    BuyRecord new_br = {
-                        order.order_id,
-                        t_price,
-                        left_volume};
-                    decl_book.insertBuyDecl(new_br);
-
-                    left_volume -= left_volume;
-                }
-            }
-        }
-    } else if (order.direction == -1) {
-        /* Sell out */
-        BuyRecord* br = decl_book.queryBuyFirst();
+    /* 集中申报簿中，对手方无申报：直接撤回此申报 */
+    if (r == nullptr)
+        return -1;
 
-        if (br == nullptr)
-            return -1;
+    /* NOTE: 可能需要比对多组价格相同的申报 */
+    price_t t_price = r->price;
+    int left_volume = matchOpposite<Side>(order, order.volume, [&](typename Side::OppRecord* opp) {
+        return opp->price != t_price;
+    });
 
-        double t_price = br->price;
-        int left_volume = order.volume;
-
-        while (left_volume) {
-            if (left_volume < br->volume) {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     br->order_id,
-                    ask_id:     order.order_id,
-                    price:      t_price,
-                    volume:     left_volume,
-                };
-                produceTrade(new_trade);
-
-                br->volume -= left_volume;
-                left_volume -= left_volume;
-            } else {
-                Trade new_trade = {
-                    stk_code:    stk_code,
-                    bid_id:      br->order_id,
-                    ask_id:      order.order_id,
-                    price:       t_price,
-                    volume:      br->volume,
-                };
-                produceTrade(new_trade);
-
-                left_volume -= br->volume;
-                decl_book.removeBuyFirst();
-
-                if (left_volume == 0)
-                    break;
-
-                br = decl_book.queryBuyFirst();
-                if (br == nullptr || br->price != t_price) {
-                    SellRecord new_sr = {
-                        order.order_id,
-                        t_price,
-                        left_volume};
-                    decl_book.insertSellDecl(new_sr);
-
-                    left_volume -= left_volume;
-                }
-            }
-        }
-    } else {
-        ex_debug("strange order direction: %d\n", order.direction);
+    if (left_volume != 0) {
+        /* 对手方第一价格不足交易，将剩余部分以限价形式记录在集中申报簿中 */
+        typename Side::OwnRecord new_r = {
+            order.order_id,
+            t_price,
+            left_volume};
+        Side::insertOwn(decl_book, new_r);
     }
+
     return 0;
 }
 
 /* Type 2 */
-int StockExchange::handleOurBest(Order& order)
+template <typename Side>
+int StockExchange::handleOurBest(const Order& order)
 {
     /* 以申报进入交易主机时集中申报簿中本方队列的最优价格为其申报价格。*/
-    if (order.direction == 1) {
-        /* Buy in */
-        BuyRecord* br = decl_book.queryBuyFirst();
-
-        /* 如果本方（买方）队列为空，撤销当前申报 */
-        if (br == nullptr)
-            return -1; /* fully reject */
-
-        double t_price = br->price;
-
-        /**
-         * NOTE:
-         * 由于本方第一（买1）都还不能成交，因而该申报会直接进入集中申报簿，不会产生新的交易
-         */
-        BuyRecord new_br = {
-            order.order_id,
-            t_price,
-            order.volume};
-        decl_book.insertBuyDecl(new_br);
-    } else if (order.direction == -1) {
-        /* Sell out */
-        SellRecord *sr = decl_book.querySellFirst();
+    typename Side::OwnRecord* r = Side::queryOwn(decl_book);
 
-        if (sr == nullptr)
-            return -1; /* fully reject */
+    /* 如果本方队列为空，撤销当前申报 */
+    if (r == nullptr)
+        return -1; /* fully reject */
 
-        double t_price = sr->price;
+    /**
+     * NOTE:
+     * 由于本方第一都还不能成交，因而该申报会直接进入集中申报簿，不会产生新的交易
+     */
+    typename Side::OwnRecord new_r = {
+        order.order_id,
+        r->price,
+        order.volume};
+    Side::insertOwn(decl_book, new_r);
 
-        SellRecord new_sr = {
-            order.order_id,
-            t_price,
-            order.volume};
-        decl_book.insertSellDecl(new_sr);
-    } else {
-        ex_debug("strange order direction: %d\n", order.direction);
-    }
     return 0;
 }
 
 /* Type 3 */
-int StockExchange::handleFiveLevelOtherCancel(Order& order)
+template <typename Side>
+int StockExchange::handleFiveLevelOtherCancel(const Order& order)
 {
     /**
      * 依次与对手方前五档价格进行成交
      *
      * NOTE:
      * 1. 五档指的是五个不同价格，相同价格属于一档，也就是说需要匹配五个不同价格
+     * 2. 可成交量由申报簿的聚合索引直接给出，撮合时无需再逐条比较价格
      */
-    if (order.direction == 1) {
-        /* Buy in */
-        int left_volume = order.volume;
-        int level_count = 0;
-        double previous_price = 0;
-        while (true) {
-            if (left_volume == 0)
-                break;
-            SellRecord *sr = decl_book.querySellFirst();
-            if (sr == nullptr)
-                break;
-
-            if (sr->price != previous_price) {
-                if (++level_count > 5)
-                    break;
-                previous_price = sr->price;
-            }
-
-            if (left_volume < sr->volume) {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     order.order_id,
-                    ask_id:     sr->order_id,
-                    price:      sr->price,
-                    volume:     left_volume,
-                };
-                produceTrade(new_trade);
-
-                sr->volume -= left_volume;
-                left_volume -= left_volume;
-            } else {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     order.order_id,
-                    ask_id:     sr->order_id,
-                    price:      sr->price,
-                    volume:     sr->volume,
-                };
-                produceTrade(new_trade);
-
-                left_volume -= sr->volume;
-                decl_book.removeSellFirst();
-            }
-        }
-        if (left_volume) {
-            // ex_debug("Type3: left_volume=%d\n", left_volume);
-            return left_volume; /* partial reject */
-        }
-    } else if (order.direction == -1) {
-        /* Sell out */
-        int left_volume = order.volume;
-        int level_count = 0;
-        double previous_price = 0;
-        while (true) {
-            if (left_volume == 0)
-                break;
-            BuyRecord *br = decl_book.queryBuyFirst();
-            if (br == nullptr)
-                break;
-
-            if (br->price != previous_price) {
-                if (++level_count > 5)
-                    break;
-                previous_price = br->price;
-            }
-
-            if (left_volume < br->volume) {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     br->order_id,
-                    ask_id:     order.order_id,
-                    price:      br->price,
-                    volume:     left_volume,
-                };
-                produceTrade(new_trade);
-
-                br->volume -= left_volume;
-                left_volume -= left_volume;
-            } else {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     br->order_id,
-                    ask_id:     order.order_id,
-                    price:      br->price,
-                    volume:     br->volume,
-                };
-                produceTrade(new_trade);
-
-                left_volume -= br->volume;
-                decl_book.removeBuyFirst();
-            }
-        }
-    } else {
-        ex_debug("strange order direction: %d\n", order.direction);
+    int left_volume = order.volume;
+    int fill_volume = std::min<int64_t>(left_volume, Side::oppositeVolumeWithinLevels(decl_book, 5));
+    matchOpposite<Side>(order, fill_volume, NoStop());
+
+    left_volume -= fill_volume;
+    if (left_volume) {
+        // ex_debug("Type3: left_volume=%d\n", left_volume);
+        return left_volume; /* partial reject */
     }
 
     return 0;
 }
 
 /* Type 4 */
-int StockExchange::handleImmediateOtherCancel(Order& order)
+template <typename Side>
+int StockExchange::handleImmediateOtherCancel(const Order& order)
 {
     /* 匹配对手方所有申报并交易，如果对手方交易空，则撤销剩余 */
     int left_volume = order.volume;
-    if (order.direction == 1) {
-        /* Buy in */
-        while (true) {
-            if (left_volume == 0)
-                break;
-            SellRecord *sr = decl_book.querySellFirst();
-            if (sr == nullptr)
-                break;
-
-            if (left_volume < sr->volume) {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     order.order_id,
-                    ask_id:     sr->order_id,
-                    price:      sr->price,
-                    volume:     left_volume,
-                };
-                produceTrade(new_trade);
-
-                sr->volume -= left_volume;
-                left_volume -= left_volume;
-            } else {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     order.order_id,
-                    ask_id:     sr->order_id,
-                    price:      sr->price,
-                    volume:     sr->volume,
-                };
-                produceTrade(new_trade);
-
-                left_volume -= sr->volume;
-                decl_book.removeSellFirst();
-            }
-        }
-        if (left_volume) {
-            // ex_debug("Type4: left_volume=%d\n", left_volume);
-            return left_volume; /* partial reject */
-        }
-    } else if (order.direction == -1) {
-        /* Sell out */
-        while (true) {
-            if (left_volume == 0)
-                break;
-            BuyRecord *br = decl_book.queryBuyFirst();
-            if (br == nullptr)
-                break;
-
-            if (left_volume < br->volume) {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     br->order_id,
-                    ask_id:     order.order_id,
-                    price:      br->price,
-                    volume:     left_volume,
-                };
-                produceTrade(new_trade);
-
-                br->volume -= left_volume;
-                left_volume -= left_volume;
-            } else {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     br->order_id,
-                    ask_id:     order.order_id,
-                    price:      br->price,
-                    volume:     br->volume,
-                };
-                produceTrade(new_trade);
-
-                left_volume -= br->volume;
-                decl_book.removeBuyFirst();
-            }
-        }
-        if (left_volume) {
-            // ex_debug("Type4: left_volume=%d\n", left_volume);
-            return left_volume; /* partial reject */
-        }
-    } else {
-        ex_debug("strange order direction: %d\n", order.direction);
+    int fill_volume = std::min<int64_t>(left_volume, Side::oppositeTotalVolume(decl_book));
+    matchOpposite<Side>(order, fill_volume, NoStop());
+
+    left_volume -= fill_volume;
+    if (left_volume) {
+        // ex_debug("Type4: left_volume=%d\n", left_volume);
+        return left_volume; /* partial reject */
     }
 
     return 0;
 }
 
 /* Type 5 */
-int StockExchange::handleWholeOrCancel(Order& order)
+template <typename Side>
+int StockExchange::handleWholeOrCancel(const Order& order)
 {
     /* 与 4 类似，但是如果一旦不能全额成交，则整个撤回 */
 
-    int left_volume = order.volume;
-    if (order.direction == 1) {
-        /* Buy in */
+    /* 如果当前申报的总量大于了集中申报簿中对手方的总量，撤回 */
+    if (order.volume > Side::oppositeTotalVolume(decl_book))
+        return -1;
 
-        /* 如果当前申报的总量大于了集中申报簿中对手方的总量，撤回 */
-        if (left_volume > decl_book.totalSellVolume())
-            return -1;
+    /* 保证可以清零 left_volume */
+    matchOpposite<Side>(order, order.volume, NoStop());
 
-        while (left_volume) {
-            /* 保证可以清零 left_volume */
-            SellRecord *sr = decl_book.querySellFirst();
-            assert(sr);
-
-            if (left_volume < sr->volume) {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     order.order_id,
-                    ask_id:     sr->order_id,
-                    price:      sr->price,
-                    volume:     left_volume,
-                };
-                produceTrade(new_trade);
-
-                sr->volume -= left_volume;
-                left_volume -= left_volume;
-            } else {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     order.order_id,
-                    ask_id:     sr->order_id,
-                    price:      sr->price,
-                    volume:     sr->volume,
-                };
-                produceTrade(new_trade);
-
-                left_volume -= sr->volume;
-                decl_book.removeSellFirst();
-            }
-        }
+    return 0;
+}
 
-    } else if (order.direction == -1) {
-        /* Sell out */
-        if (left_volume > decl_book.totalBuyVolume())
+template <typename Side>
+int StockExchange::commitSide(const Order& order) {
+    switch (order.type) {
+        case 0: /* 限价申报 */
+            return handleLimitOrder<Side>(order);
+        case 1: /* 对手方最优价格申报 */
+            return handleCounterpartyBest<Side>(order);
+        case 2: /* 本方最优价格申报 */
+            return handleOurBest<Side>(order);
+        case 3: /* 最优五档即时成交剩余撤销申报 */
+            return handleFiveLevelOtherCancel<Side>(order);
+        case 4: /* 即时成交剩余撤销申报 */
+            return handleImmediateOtherCancel<Side>(order);
+        case 5: /* 全额成交或撤销申报 */
+            return handleWholeOrCancel<Side>(order);
+        default:
+            ex_debug("exchange type: %d\n", order.type);
             return -1;
-
-        while (left_volume) {
-            BuyRecord *br = decl_book.queryBuyFirst();
-            assert(br);
-
-            if (left_volume < br->volume) {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     br->order_id,
-                    ask_id:     order.order_id,
-                    price:      br->price,
-                    volume:     left_volume,
-                };
-                produceTrade(new_trade);
-
-                br->volume -= left_volume;
-                left_volume -= left_volume;
-            } else {
-                Trade new_trade = {
-                    stk_code:   stk_code,
-                    bid_id:     br->order_id,
-                    ask_id:     order.order_id,
-                    price:      br->price,
-                    volume:     br->volume,
-                };
-                produceTrade(new_trade);
-
-                left_volume -= br->volume;
-                decl_book.removeBuyFirst();
-            }
-        }
-    } else {
-        ex_debug("strange order direction: %d\n", order.direction);
     }
-
-    return 0;
 }
 
-int StockExchange::commitOrder(Order& order) {
+int StockExchange::commitOrder(const Order& order) {
     /**
-     * 1. split by order type
-     * 2. handle for each type, and return status
+     * 1. skip cancelled order
+     * 2. dispatch by direction once, then split by order type inside the side-specialized kernel
      */
     int ret = 0;
 
-    switch (order.type) {
-        case -1: { /* Cancelled Order */
-            ret = 0;
-            break;
-        }
-        case 0: { /* 限价申报 */
-            ret = handleLimitOrder(order);
-            break;
-        }
-        case 1: { /* 对手方最优价格申报 */
-            ret = handleCounterpartyBest(order);
-            break;
-        }
-        case 2: { /* 本方最优价格申报 */
-            ret = handleOurBest(order);
-            break;
-        }
-        case 3: { /* 最优五档即时成交剩余撤销申报 */
-            ret = handleFiveLevelOtherCancel(order);
-            break;
-        }
-        case 4: { /* 即时成交剩余撤销申报 */
-            ret = handleImmediateOtherCancel(order);
+    if (order.type == -1) /* Cancelled Order */
+        return 0;
+
+    switch (order.direction) {
+        case 1: { /* Buy in */
+            ret = commitSide<BuySide>(order);
             break;
         }
-        case 5: { /* 全额成交或撤销申报 */
-            ret = handleWholeOrCancel(order);
+        case -1: { /* Sell out */
+            ret = commitSide<SellSide>(order);
             break;
         }
         default: {
-            ex_debug("exchange type: %d\n", order.type);
+            ex_debug("strange order direction: %d\n", order.direction);
             return -1;
         }
     }
@@ -660,4 +335,22 @@ int StockExchange::commitOrder(Order& order) {
     return 0;
 }
 
-}  // namespace ubiquant
\ No newline at end of file
+int StockExchange::cancelOrder(int order_id) {
+    int ret = decl_book.cancelDecl(order_id);
+    if (ret < 0) {
+        ex_debug("[%d] cancel: not in decl book\n", order_id);
+        return -1;
+    }
+    return 0;
+}
+
+int StockExchange::reduceOrder(int order_id, int volume) {
+    int ret = decl_book.reduceDecl(order_id, volume);
+    if (ret < 0) {
+        ex_debug("[%d] reduce: not in decl book\n", order_id);
+        return -1;
+    }
+    return 0;
+}
+
+}  // namespace ubiquant
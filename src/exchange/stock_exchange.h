@@ -3,13 +3,19 @@
 #include "common/type.hpp"
 #include "common/global.hpp"
 #include "stock_decl_book.hpp"
+#include "stock_ladder_book.hpp"
 #include "record.hpp"
+#include "side_policy.hpp"
+#include "book_snapshot.hpp"
 #include "debug.hpp"
 #include "exchange.h"
 
 namespace ubiquant {
 
-class StockExchange : public ubi_thread {
+/* 集中申报簿的实现：StockLadderBook（价格档位数组）或 StockDeclarationBook（二叉堆） */
+using DeclBook = StockLadderBook;
+
+class StockExchange {
 /**
  * @brief 单只股票的 exchange 处理
  */
@@ -18,44 +24,87 @@ private:
     /* 股票编号 */
     int stk_code;
     /* 集中申报簿 */
-    StockDeclarationBook decl_book;
-    /* 尚未轮到的 order */
-    std::vector<Order> not_ready_orders;
+    DeclBook decl_book;
+    /* 按 order_id 排好序的 order 窗口（由 Exchange 持有） */
+    SlidingWindow<Order>* order_window = nullptr;
     /* 最后成功 commit 的 order_id */
     int last_commit_order_id;
 
     /* 输出：Trade 的序列 */
-    std::vector<Trade> trade_list;
+    std::vector<CommTrade> trade_list;
+
+    /* 当前批次（一批 order）产生的 Trade，复用同一块内存 */
+    constexpr static size_t TRADE_BATCH_RESERVE = 4096;
+    std::vector<CommTrade> trade_batch;
+
+    /* 申报簿快照的双缓冲，一个在后台写盘时使用另一个 */
+    BookSnapshot snapshots[2];
+    /* 下一次快照时的 last_commit_order_id */
+    int next_snapshot_order_id;
+
+    void takeSnapshot();
 
-    /* helpers */
-    static bool orderGtById(Order& o1, Order& o2) {
-        return o1.order_id > o2.order_id;
-    };
+    // Matching kernel, specialized on the side of the incoming order (BuySide / SellSide)
+    template <typename Side, typename Stop>
+    int matchOpposite(const Order& order, int volume, Stop stop);
+
+    template <typename Side>
+    int commitSide(const Order& order);
 
     // Different handler for type 0 - 5
-    int handleLimitOrder(Order& order);
-    int handleCounterpartyBest(Order& order);
-    int handleOurBest(Order& order);
-    int handleFiveLevelOtherCancel(Order& order);
-    int handleImmediateOtherCancel(Order& order);
-    int handleWholeOrCancel(Order& order);
+    template <typename Side>
+    int handleLimitOrder(const Order& order);
+    template <typename Side>
+    int handleCounterpartyBest(const Order& order);
+    template <typename Side>
+    int handleOurBest(const Order& order);
+    template <typename Side>
+    int handleFiveLevelOtherCancel(const Order& order);
+    template <typename Side>
+    int handleImmediateOtherCancel(const Order& order);
+    template <typename Side>
+    int handleWholeOrCancel(const Order& order);
 
 public:
-    StockExchange(int stk_code);
+    StockExchange(int stk_code, price_t lower_limit, price_t upper_limit);
+
+    // 由 Exchange 在构造时设置
+    inline void setOrderWindow(SlidingWindow<Order>* window) { order_window = window; }
+
+    // 把申报簿等大块内存迁移到负责撮合的 worker 所在的 NUMA 节点，只能在撮合开始之前调用
+    void bindMemory(int node) const;
 
-    void run() override;
+    // 处理窗口中一批就绪的 order 并发出成交与确认（由 MatchScheduler 的 worker 调用），返回 commit 的 order 数
+    size_t process();
 
-    std::vector<Order> comsumeOrder();
+    size_t comsumeOrder();
 
-    void produceTrade(Trade& new_trade);
+    void produceTrade(CommTrade& new_trade);
 
-    inline std::vector<Trade>& getTradeList() {
+    void flushTrades();
+
+    inline std::vector<CommTrade>& getTradeList() {
         return trade_list;
     }
 
-    int receiveOrder(Order& order);
+    // trades produced since the last flushTrades(), for callers that drive receiveOrder() directly
+    inline std::vector<CommTrade>& getTradeBatch() {
+        return trade_batch;
+    }
+
+    int receiveOrder(const Order& order);
+
+    int commitOrder(const Order& order);
+
+    // 从快照恢复申报簿与 last_commit_order_id，只能在撮合开始之前调用
+    void restoreSnapshot(const BookSnapshot& snapshot);
+
+    inline int getLastCommitOrderId() const { return last_commit_order_id; }
+
+    // 撤销 / 减量一笔仍在集中申报簿中的申报，申报不在申报簿中时返回 -1
+    int cancelOrder(int order_id);
 
-    int commitOrder(Order& order);
+    int reduceOrder(int order_id, int volume);
 };
 
 }  // namespace ubiquant
\ No newline at end of file
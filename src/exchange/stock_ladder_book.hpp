@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "debug.hpp"
+#include "price_ladder.hpp"
+#include "record.hpp"
+
+namespace ubiquant {
+
+class StockLadderBook {
+/**
+ * @brief 基于价格档位数组的集中申报簿
+ *
+ * 与 `StockDeclarationBook` 接口一致，但申报不再存放在二叉堆中：
+ * 价格只可能落在前收盘价 ±10% 的涨跌停区间内，因此为区间内
+ * 每个 tick（0.01）分配一个档位，档位内部按时间先后排队（FIFO），
+ * 最优买价/卖价由档位位图的 count-trailing-zeros 直接得到。
+ *
+ * 插入、取最优、删除最优均为 O(1)（位图查找与档位数成正比，但常数极小）。
+ * 深度查询（对手方总量、前 K 档总量、优于等于某价格的总量）为 O(log L)。
+ *
+ * 同一只股票的 order_id 是连续的，因此 order_id -> 挂单 slot 的索引直接用数组保存，
+ * 撤单（`cancelDecl`）与减量（`reduceDecl`）均为 O(1) 查找加 O(log L) 的聚合量更新。
+ */
+private:
+    PriceLadder<BuyRecord, true> buy_decls;
+    PriceLadder<SellRecord, false> sell_decls;
+
+    /**
+     * order_id -> 挂单位置，0 表示该申报不在申报簿中；
+     * 否则最低位为方向（0 买 1 卖），其余位为 slot + 1
+     */
+    constexpr static size_t ORDER_INDEX_RESERVE = 0x10000;
+    huge_vector<uint32_t> order_index;
+
+    inline void indexOrder(int order_id, uint32_t slot, uint32_t sell) {
+        assert(order_id >= 0);
+        if ((size_t)order_id >= order_index.size())
+            order_index.resize(std::max<size_t>(order_id + 1, order_index.size() * 2), 0);
+        order_index[order_id] = ((slot + 1) << 1) | sell;
+    }
+
+    inline uint32_t lookupOrder(int order_id) const {
+        if (order_id < 0 || (size_t)order_id >= order_index.size())
+            return 0;
+        return order_index[order_id];
+    }
+
+public:
+    StockLadderBook(price_t lower_limit, price_t upper_limit)
+        : buy_decls(lower_limit, upper_limit), sell_decls(lower_limit, upper_limit), order_index(ORDER_INDEX_RESERVE, 0) {}
+
+    /* 在撮合开始之前调用，见 MatchScheduler::start */
+    void bindMemory(int node) const {
+        buy_decls.bindMemory(node);
+        sell_decls.bindMemory(node);
+        ubiquant::bind_memory(order_index, node);
+    }
+
+    void print() {
+        std::cout << "BuyDecls:" << std::endl;
+        buy_decls.print();
+        std::cout << "SellDecls:" << std::endl;
+        sell_decls.print();
+    }
+
+    int insertBuyDecl(BuyRecord& br) {
+        assert(br.volume != 0);
+        indexOrder(br.order_id, buy_decls.insert(br), 0);
+        return 0;
+    }
+
+    int insertSellDecl(SellRecord& sr) {
+        assert(sr.volume != 0);
+        indexOrder(sr.order_id, sell_decls.insert(sr), 1);
+        return 0;
+    }
+
+    inline BuyRecord* queryBuyFirst() {
+        return buy_decls.queryFirst();
+    }
+
+    inline void reduceBuyFirst(int volume) {
+        buy_decls.reduceFirst(volume);
+    }
+
+    inline void removeBuyFirst() {
+        order_index[buy_decls.queryFirst()->order_id] = 0;
+        buy_decls.removeFirst();
+    }
+
+    inline SellRecord* querySellFirst() {
+        return sell_decls.queryFirst();
+    }
+
+    inline void reduceSellFirst(int volume) {
+        sell_decls.reduceFirst(volume);
+    }
+
+    inline void removeSellFirst() {
+        order_index[sell_decls.queryFirst()->order_id] = 0;
+        sell_decls.removeFirst();
+    }
+
+    /* 撤销挂单，返回被撤销的剩余数量；申报不在申报簿中时返回 -1 */
+    int cancelDecl(int order_id) {
+        uint32_t ref = lookupOrder(order_id);
+        if (ref == 0)
+            return -1;
+        order_index[order_id] = 0;
+        uint32_t slot = (ref >> 1) - 1;
+        return (ref & 1) ? sell_decls.remove(slot) : buy_decls.remove(slot);
+    }
+
+    /* 挂单减量 volume（保留时间优先级），减至 0 时等同于撤单；申报不在申报簿中时返回 -1 */
+    int reduceDecl(int order_id, int volume) {
+        assert(volume > 0);
+        uint32_t ref = lookupOrder(order_id);
+        if (ref == 0)
+            return -1;
+        uint32_t slot = (ref >> 1) - 1;
+        Record* r = (ref & 1) ? (Record*)sell_decls.at(slot) : (Record*)buy_decls.at(slot);
+        if (volume >= r->volume) {
+            cancelDecl(order_id);
+            return 0;
+        }
+        if (ref & 1)
+            sell_decls.reduce(slot, volume);
+        else
+            buy_decls.reduce(slot, volume);
+        return 0;
+    }
+
+    inline size_t numBuyDecls() const { return buy_decls.size(); }
+    inline size_t numSellDecls() const { return sell_decls.size(); }
+
+    /* 按照优先级遍历挂单，用于 snapshot；按同样顺序重新插入即可恢复申报簿 */
+    template <typename F>
+    void forEachBuyDecl(F f) {
+        buy_decls.forEach(f);
+    }
+
+    template <typename F>
+    void forEachSellDecl(F f) {
+        sell_decls.forEach(f);
+    }
+
+    inline int64_t totalBuyVolume() {
+        return buy_decls.totalVolume();
+    }
+
+    inline int64_t totalSellVolume() {
+        return sell_decls.totalVolume();
+    }
+
+    inline int64_t buyVolumeWithinLevels(int k) {
+        return buy_decls.volumeWithinLevels(k);
+    }
+
+    inline int64_t sellVolumeWithinLevels(int k) {
+        return sell_decls.volumeWithinLevels(k);
+    }
+
+    inline int64_t buyVolumeAtOrBetter(price_t price) {
+        return buy_decls.volumeAtOrBetter(price);
+    }
+
+    inline int64_t sellVolumeAtOrBetter(price_t price) {
+        return sell_decls.volumeAtOrBetter(price);
+    }
+};
+
+}  // namespace ubiquant
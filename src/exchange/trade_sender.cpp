@@ -1,122 +1,158 @@
 #include "trade_sender.h"
 
+#include <algorithm>
+
 #include "common/monitor.hpp"
 
 namespace ubiquant {
 
 ExchangeTradeSender::ExchangeTradeSender()
-    : msg_queue_(Config::sliding_window_size * Config::stock_num / 2) {
-
-    pthread_spin_init(&send_lock, 0);
-
-    // init msg senders
+    : trade_buffers_(MsgBuffer::bytes_for<CommTrade>(TRADES_PER_BUFFER)),
+      resend_buffers_(MsgBuffer::bytes_for<OrderAck>(1)) {
+    // one sender per trader
     for (int i = 0; i < Config::trader_num; i++) {
-        std::pair<int, int> port_pair;
-        auto& channels = Config::trader_port2exchange_port[i][Config::partition_idx];
-        port_pair = {channels[2].second, channels[2].first};
-        msg_senders_.push_back(std::make_shared<MessageSender>(
-            Config::exchanges_addr[Config::partition_idx], 
-            Config::traders_addr[i], 
-            port_pair));
+        senders_.emplace_back(new TraderSender(i, Config::sliding_window_size * Config::stock_num / 2));
+    }
+}
+
+void ExchangeTradeSender::start() {
+    for (auto& sender : senders_) {
+        sender->start();
     }
 }
 
 void ExchangeTradeSender::stop() {
-    std::cout << "ExchangeTradeSender Lock send lock" << std::endl;
-    pthread_spin_lock(&send_lock);
-    std::cout << "ExchangeTradeSender Lock send lock success" << std::endl;
+    std::cout << "ExchangeTradeSender pause" << std::endl;
+    for (auto& sender : senders_) {
+        sender->stop();
+    }
+    std::cout << "ExchangeTradeSender pause success" << std::endl;
 }
 
 void ExchangeTradeSender::restart() {
-    std::cout << "ExchangeTradeSender Unlock send lock" << std::endl;
-    pthread_spin_unlock(&send_lock);
-    std::cout << "ExchangeTradeSender Unlock send lock success" << std::endl;
+    std::cout << "ExchangeTradeSender resume" << std::endl;
+    for (auto& sender : senders_) {
+        sender->restart();
+    }
+    std::cout << "ExchangeTradeSender resume success" << std::endl;
 }
 
 void ExchangeTradeSender::reset_network() {
     // reset msg senders
-    for (int i = 0; i < Config::trader_num; i++) {
-        std::pair<int, int> port_pair;
-        auto& channels = Config::trader_port2exchange_port[i][Config::partition_idx];
-        port_pair = {channels[2].second, channels[2].first};
-        msg_senders_[i]->reset_port(port_pair);
+    for (auto& sender : senders_) {
+        sender->reset_network();
     }
     after_reset = true;
 }
 
-void ExchangeTradeSender::run() {
-    logstream(LOG_EMPH) << "Exchange TradeSender is running..." << LOG_endl;
-    // Monitor monitor;
-    // monitor.start_thpt();
-    while (true) {
-        auto msg = msg_queue_.take();
-        for (int idx = 0; idx < msg_senders_.size(); idx++) {
-            bool res = false;
-            while (!res) {
-                pthread_spin_lock(&send_lock);
-                res = msg_senders_[idx]->send(msg);
-                pthread_spin_unlock(&send_lock);
-                // if(unlikely(!res)) {
-                //     std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                // }
+void ExchangeTradeSender::put_msg(MsgBuffer* msg) {
+    for (auto& sender : senders_) {
+        sender->put(msg);
+    }
+    msg->release();
+}
+
+void ExchangeTradeSender::put_trades(const std::vector<CommTrade>& trades) {
+    // fills of one incoming order always share a msg, the trader dedupes resent trades by that order id
+    auto order_of = [](const CommTrade& trade) { return std::max(trade.bid_id, trade.ask_id); };
+
+    // one trade msg per TRADES_PER_BUFFER trades of the batch at most, cut between two incoming orders
+    for (size_t first = 0, last; first < trades.size(); first = last) {
+        last = std::min(first + TRADES_PER_BUFFER, trades.size());
+        if (last < trades.size()) {
+            size_t cut = last;
+            while (cut > first && order_of(trades[cut - 1]) == order_of(trades[cut]))
+                cut--;
+            if (cut != first) {
+                last = cut;
+            } else {
+                // a single order with more fills than a buffer takes a one-off buffer
+                while (last < trades.size() && order_of(trades[last]) == order_of(trades[first]))
+                    last++;
             }
         }
-
-        // monitor.add_cnt();
-        // monitor.print_timely_thpt("Trade Sender Throughput");
+        MsgBuffer* msg = trade_buffers_.acquire(MsgBuffer::bytes_for<CommTrade>(last - first));
+        msg->begin(MSG_TYPE::TRADE_MSG);
+        msg->append(trades.data() + first, last - first);
+        put_msg(msg);
     }
-    // monitor.end_thpt();
 }
 
-CommTrade convert_trade_to_commtrade(const Trade& trade) {
-    return CommTrade{
-        stk_code : trade.stk_code,
-        bid_id : trade.bid_id,
-        ask_id : trade.ask_id,
-        dummy : 0,
-        price : trade.price,
-        volume : trade.volume
-    };
+void ExchangeTradeSender::put_resend_request(const OrderAck& ack) {
+    MsgBuffer* msg = resend_buffers_.acquire(MsgBuffer::bytes_for<OrderAck>(1));
+    msg->begin(MSG_TYPE::RESEND_MSG);
+    msg->append(&ack, 1);
+    put_msg(msg);
+}
+
+ExchangeTradeSender::TraderSender::TraderSender(int trader, size_t queue_size)
+    : trader_(trader), queue_(queue_size), waiter_(Config::send_wait_strategy) {
+    msg_sender_ = std::make_shared<MessageSender>(
+        Config::exchanges_addr[Config::partition_idx],
+        Config::traders_addr[trader_],
+        port_pair());
 }
 
-void ExchangeTradeSender::put_trade(Trade& trade) {
-    // build trade msg
-    std::string trade_msg;
-    uint32_t msg_code = MSG_TYPE::TRADE_MSG;
-    uint32_t cnt = 1;
-    CommTrade commTrade = convert_trade_to_commtrade(trade);
-    trade_msg.append((char*)&msg_code, sizeof(uint32_t));
-    trade_msg.append((char*)&cnt, sizeof(uint32_t));
-    trade_msg.append((char*)&commTrade, sizeof(commTrade));
-
-    // std::cout << "before serial trade:" << trade_msg.size() << std::endl;
-    // trade.print();
-    // std::cout << "after serial trade " << std::endl;
-
-    // TODO!: debug
-    // std::vector<Trade> out_trades;
-    // size_t out_offset = sizeof(uint32_t); // skip msg code
-    // uint32_t out_cnt = 0;
-    // get_elem_from_buf(trade_msg.c_str(), out_offset, out_cnt);
-    // out_trades.resize(out_cnt);
-    // std::cout << "out cnt=" << out_cnt << std::endl;
-    // for(auto& trade : out_trades) {
-    //     get_elem_from_buf(trade_msg.c_str(), out_offset, trade);
-    //     trade.print();
-    // }
-
-    msg_queue_.put(trade_msg);
+std::pair<int, int> ExchangeTradeSender::TraderSender::port_pair() const {
+    auto& channels = Config::trader_port2exchange_port[trader_][Config::partition_idx];
+    return {channels[TRADE_CHANNEL].second, channels[TRADE_CHANNEL].first};
 }
 
-void ExchangeTradeSender::put_order_ack(OrderAck& ack) {
-    // build ack msg
-    std::string ack_msg;
-    uint32_t msg_code = MSG_TYPE::ORDER_ACK_MSG;
-    uint32_t cnt = 1;
-    ack_msg.append((char*)&msg_code, sizeof(uint32_t));
-    ack_msg.append((char*)&cnt, sizeof(uint32_t));
-    ack_msg.append((char*)&ack, sizeof(ack));
-    msg_queue_.put(ack_msg);
+void ExchangeTradeSender::TraderSender::reset_network() {
+    msg_sender_->reset_port(port_pair());
+}
+
+void ExchangeTradeSender::TraderSender::put(MsgBuffer* msg) {
+    msg->retain();
+    if (depth_.fetch_add(1, std::memory_order_relaxed) >= queue_.get_capacity())
+        blocked_puts_.fetch_add(1, std::memory_order_relaxed);
+    queue_.put(QueuedMsg{msg, timer::get_usec()});
+}
+
+void ExchangeTradeSender::TraderSender::send(const QueuedMsg& queued) {
+    // retry until sent, a paused sender (e.g. while the network is reset) resumes the same message
+    while (!msg_sender_->send(queued.msg)) {
+        pause_.checkpoint();
+    }
+    queued.msg->release();
+
+    uint64_t lag = timer::get_usec() - queued.enqueue_usec;
+    sent_++;
+    total_lag_usec_ += lag;
+    max_lag_usec_ = std::max(max_lag_usec_, lag);
+    max_depth_ = std::max(max_depth_, depth_.fetch_sub(1, std::memory_order_relaxed));
+}
+
+void ExchangeTradeSender::TraderSender::report(uint64_t now) {
+    if (now - last_report_usec_ < REPORT_INTERVAL_US)
+        return;
+    if (sent_ != 0) {
+        Global<LogBuffer>::Get()->add_log(
+            "Trade Sender [" + std::to_string(trader_) + "] " + std::to_string(sent_) + " msgs, depth max "
+            + std::to_string(max_depth_) + "/" + std::to_string(queue_.get_capacity()) + ", "
+            + std::to_string(blocked_puts_.load(std::memory_order_relaxed)) + " blocked puts, lag avg "
+            + std::to_string(total_lag_usec_ / sent_) + " us max " + std::to_string(max_lag_usec_) + " us\n");
+    }
+    last_report_usec_ = now;
+    sent_ = total_lag_usec_ = max_lag_usec_ = max_depth_ = 0;
+}
+
+void ExchangeTradeSender::TraderSender::run() {
+    queue_.bind_memory(pin_thread("trade_sender", trader_));
+    logstream(LOG_EMPH) << "Exchange TradeSender [" << trader_ << "] is running..." << LOG_endl;
+    last_report_usec_ = timer::get_usec();
+    while (true) {
+        pause_.checkpoint();
+
+        auto send_one = [this](const QueuedMsg& queued) { send(queued); };
+        size_t cnt = queue_.drain(send_one, SEND_BATCH);
+        if (cnt == 0 && !waiter_.backoff())
+            cnt = queue_.take(send_one, SEND_BATCH, PARK_TIMEOUT);
+        if (cnt != 0)
+            waiter_.reset();
+
+        report(timer::get_usec());
+    }
 }
 
 }  // namespace ubiquant
@@ -1,37 +1,106 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 
-#include "common/block_queue.hpp"
+#include "common/mpsc_ring.hpp"
 #include "common/thread.h"
+#include "common/topology.hpp"
+#include "common/wait_strategy.hpp"
 #include "common/type.hpp"
 #include "network/msg_sender.h"
 
 namespace ubiquant {
 
-class ExchangeTradeSender : public ubi_thread {
+/**
+ * Trade sending side of the exchange: one thread and one bounded queue per trader.
+ *
+ * A message is built once in a pooled MsgBuffer, every trader's queue holds one reference to it
+ * and its frame goes out zero-copy, so the payload is never copied per trader. A slow or
+ * reconnecting trader only backs up its own queue; the producers block on it once it is full.
+ * Each trader's queue depth, blocked puts and lag (enqueue to send) are logged every second.
+ */
+class ExchangeTradeSender {
 public:
     ExchangeTradeSender();
 
-    void run() override;
+    void start();
 
-    void put_trade(Trade& trade);
+    void put_trades(const std::vector<CommTrade>& trades);
 
-    void put_order_ack(OrderAck& ack);
+    // ack.order_id is the first order id the trader has to resend; sent in order with the trades,
+    // so the trader knows which trades precede the resend (acks go through ExchangeAckSender)
+    void put_resend_request(const OrderAck& ack);
 
     void stop();
     void restart();
     void reset_network();
 
 protected:
-    // socket client
-    std::vector<std::shared_ptr<MessageSender>> msg_senders_;
+    // message buffers, built in place by the matching workers and sent zero-copy;
+    // a larger trade batch goes out as several msgs cut between two incoming orders,
+    // only a single order with more fills than that gets a one-off buffer
+    constexpr static size_t TRADES_PER_BUFFER = 256;
 
-    // msg queue
-    BlockQueue<std::string> msg_queue_;
+    struct QueuedMsg {
+        MsgBuffer* msg;
+        uint64_t enqueue_usec;
+    };
 
-    // sender pause lock
-    pthread_spinlock_t send_lock;
+    class TraderSender : public ubi_thread {
+    public:
+        TraderSender(int trader, size_t queue_size);
+
+        void run() override;
+
+        // takes a reference of msg for this trader
+        void put(MsgBuffer* msg);
+
+        void stop() { pause_.pause(); }
+        void restart() { pause_.resume(); }
+        void reset_network();
+
+    private:
+        constexpr static size_t SEND_BATCH = 64;
+        constexpr static uint64_t REPORT_INTERVAL_US = 1000000;
+        // an idle sender parks in queue_.take(), woken by put(); the timeout bounds how long a console pause waits
+        constexpr static std::chrono::microseconds PARK_TIMEOUT{10000};
+
+        std::pair<int, int> port_pair() const;
+        void send(const QueuedMsg& queued);
+        void report(uint64_t now);
+
+        int trader_;
+
+        // socket client
+        std::shared_ptr<MessageSender> msg_sender_;
+
+        // fed by every matching worker (trades) and the recovery (resend requests)
+        MpscRing<QueuedMsg> queue_;
+        // messages queued and not sent yet, and puts that found the queue full (backpressure)
+        std::atomic<uint64_t> depth_{0};
+        std::atomic<uint64_t> blocked_puts_{0};
+
+        // stats of the current report interval, sender thread only
+        uint64_t last_report_usec_ = 0;
+        uint64_t sent_ = 0;
+        uint64_t total_lag_usec_ = 0;
+        uint64_t max_lag_usec_ = 0;
+        uint64_t max_depth_ = 0;
+
+        WaitStrategy waiter_;
+
+        // console pause, checked between messages
+        PauseEpoch pause_;
+    };
+
+    // hand msg to every trader, then drop the producer's reference
+    void put_msg(MsgBuffer* msg);
+
+    std::vector<std::unique_ptr<TraderSender>> senders_;
+
+    MsgBufferPool trade_buffers_;
+    MsgBufferPool resend_buffers_;
 };
 
 }  // namespace ubiquant
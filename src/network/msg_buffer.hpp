@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "common/mpmc_ring.hpp"
+#include "utils/assertion.hpp"
+
+namespace ubiquant {
+
+class MsgBufferPool;
+
+/**
+ * A message built in place: header {uint32 msg_code, uint32 cnt} followed by cnt records.
+ *
+ * Reference counted: acquire() returns the buffer with one reference held by the producer,
+ * and each ZMQ frame built on it (MessageSender::send) holds one more, dropped by ZMQ's free
+ * callback once the frame is on the wire. The last release hands the buffer back to its pool.
+ */
+class MsgBuffer {
+public:
+    constexpr static size_t HEADER_SIZE = 2 * sizeof(uint32_t);
+
+    // bytes of a message of n records of T
+    template <class T>
+    constexpr static size_t bytes_for(size_t n) { return HEADER_SIZE + n * sizeof(T); }
+
+    inline char* data() { return data_.get(); }
+    inline size_t size() const { return size_; }
+
+    // start a message of msg_code with no record
+    inline void begin(uint32_t msg_code) {
+        size_ = HEADER_SIZE;
+        header()[0] = msg_code;
+        header()[1] = 0;
+    }
+
+    inline uint32_t count() const { return ((const uint32_t*)data_.get())[1]; }
+
+    // room for more records of T, to be written in place at tail<T>() and then committed
+    template <class T>
+    inline size_t room() const { return (capacity_ - size_) / sizeof(T); }
+    template <class T>
+    inline T* tail() { return (T*)(data_.get() + size_); }
+    template <class T>
+    inline void commit(size_t n) {
+        ASSERT(n <= room<T>());
+        size_ += n * sizeof(T);
+        header()[1] += n;
+    }
+
+    template <class T>
+    inline void append(const T* records, size_t n) {
+        ASSERT(n <= room<T>());
+        memcpy((void*)tail<T>(), records, n * sizeof(T));
+        commit<T>(n);
+    }
+
+    inline void retain() { refs_.fetch_add(1, std::memory_order_relaxed); }
+    inline void release();
+
+private:
+    friend class MsgBufferPool;
+
+    MsgBuffer(MsgBufferPool* pool, size_t capacity) : pool_(pool), capacity_(capacity), data_(new char[capacity]) {}
+
+    inline uint32_t* header() { return (uint32_t*)data_.get(); }
+
+    // nullptr for a one-off buffer larger than the pool's buffers
+    MsgBufferPool* const pool_;
+    const size_t capacity_;
+    size_t size_ = 0;
+    std::unique_ptr<char[]> data_;
+    std::atomic<int> refs_{0};
+};
+
+/**
+ * Free list of equally sized MsgBuffers.
+ * Buffers are acquired by the producers (e.g. every matching worker) and released on the ZMQ I/O thread,
+ * so the free list is a lock-free ring; a buffer released into a full ring is deleted.
+ * A request larger than buffer_size gets a one-off buffer, deleted on its last release.
+ * A pool must outlive the frames in flight (pools are owned by the long-lived senders).
+ */
+class MsgBufferPool {
+public:
+    constexpr static int DEFAULT_MAX_FREE = 4096;
+
+    explicit MsgBufferPool(size_t buffer_size, size_t prealloc = 0, int max_free = DEFAULT_MAX_FREE)
+        : buffer_size_(buffer_size), free_(std::max<int>(max_free, prealloc)) {
+        for (size_t i = 0; i < prealloc; i++) {
+            free_.try_put(new MsgBuffer(this, buffer_size_));
+        }
+    }
+
+    ~MsgBufferPool() {
+        MsgBuffer* buf;
+        while (free_.try_take(buf)) {
+            delete buf;
+        }
+    }
+
+    MsgBufferPool(const MsgBufferPool&) = delete;
+    MsgBufferPool& operator=(const MsgBufferPool&) = delete;
+
+    inline size_t buffer_size() const { return buffer_size_; }
+
+    // an empty buffer of at least bytes, holding one reference
+    MsgBuffer* acquire(size_t bytes) {
+        MsgBuffer* buf = nullptr;
+        if (bytes > buffer_size_)
+            buf = new MsgBuffer(nullptr, bytes);
+        else if (!free_.try_take(buf))
+            buf = new MsgBuffer(this, buffer_size_);
+        buf->size_ = 0;
+        buf->refs_.store(1, std::memory_order_relaxed);
+        return buf;
+    }
+
+private:
+    friend class MsgBuffer;
+
+    void recycle(MsgBuffer* buf) {
+        if (!free_.try_put(buf))
+            delete buf;
+    }
+
+    const size_t buffer_size_;
+    MpmcRing<MsgBuffer*> free_;
+};
+
+// typed records of a received message, iterated in place
+template <class T>
+struct MsgRecords {
+    const T* first;
+    const T* last;
+
+    inline const T* begin() const { return first; }
+    inline const T* end() const { return last; }
+    inline size_t size() const { return last - first; }
+};
+
+/**
+ * Read-only view of a received message (same layout as MsgBuffer), valid while the frame
+ * it points into is alive, i.e. until the receiver reuses the frame for the next message.
+ */
+class MsgView {
+public:
+    MsgView(const void* data, size_t size) : data_((const char*)data), size_(size) {
+        ASSERT(size_ >= MsgBuffer::HEADER_SIZE);
+    }
+
+    inline uint32_t msg_code() const { return ((const uint32_t*)data_)[0]; }
+    inline uint32_t count() const { return ((const uint32_t*)data_)[1]; }
+
+    template <class T>
+    inline MsgRecords<T> records() const {
+        ASSERT(size_ >= MsgBuffer::bytes_for<T>(count()));
+        const T* first = (const T*)(data_ + MsgBuffer::HEADER_SIZE);
+        return {first, first + count()};
+    }
+
+private:
+    const char* data_;
+    size_t size_;
+};
+
+inline void MsgBuffer::release() {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+    if (pool_ != nullptr)
+        pool_->recycle(this);
+    else
+        delete this;
+}
+
+}  // namespace ubiquant
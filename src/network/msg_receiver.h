@@ -9,11 +9,15 @@
 #include <unordered_map>
 #include <string>
 #include <fstream>
+#include <memory>
 #include <sstream>
 #include <thread>
 
 
 #include "common/config.h"
+#include "network/msg_buffer.hpp"
+#include "network/shm_transport.h"
+#include "network/zmq_transport.h"
 
 // utils
 #include "utils/logger2.hpp"
@@ -21,28 +25,63 @@
 
 namespace ubiquant {
 
+// how a receiver thread waits for messages (config: recv_mode)
+enum RECV_MODE {
+    RECV_TRY = 0,   // non-blocking recv round-robin over the sockets, idle per recv_wait_strategy
+    RECV_POLL = 1,  // zmq_poll / shm doorbells over all channels (recv_poll_timeout_ms), then drain every ready one
+};
+
 class MessageReceiver {
 private:
+    // poll slice of a receiver with both ZMQ and shm channels, so the rings are checked in between
+    constexpr static long MIXED_POLL_SLICE_MS = 1;
+
     zmq::context_t context;
     std::string src_addr;
     std::vector<int> ports;
-    std::vector<zmq::socket_t*> receivers;     // static allocation
+    std::vector<std::unique_ptr<RecvChannel>> receivers;    // static allocation, one per port
+    std::vector<zmq::pollitem_t> poll_items;   // one per ZMQ receiver
+    std::vector<size_t> poll_receivers;        // index in receivers of each poll item
+    std::vector<ShmRing*> shm_rings;           // one per shm receiver
 
     int offset = 0;
 
+    void init_poll() {
+        poll_items.clear();
+        poll_receivers.clear();
+        shm_rings.clear();
+        for (size_t idx = 0; idx < receivers.size(); idx++) {
+            if (receivers[idx]->transport() == TRANSPORT_SHM) {
+                shm_rings.push_back(((ShmRecvChannel*)receivers[idx].get())->ring());
+            } else {
+                poll_items.push_back({(void *)*((ZmqRecvChannel*)receivers[idx].get())->socket(), 0, ZMQ_POLLIN, 0});
+                poll_receivers.push_back(idx);
+            }
+        }
+    }
+
+    template <class F>
+    size_t drain(size_t idx, RecvFrame &frame, F&& f) {
+        size_t cnt = 0;
+        while (receivers[idx]->tryrecv(frame)) {
+            f(frame);
+            cnt++;
+        }
+        return cnt;
+    }
+
 public:
+    // each port is received over the transport the network config gives it
     MessageReceiver(std::string my_addr, std::vector<int> receiver_ports)
         : context(1), src_addr(my_addr), ports(receiver_ports) {
 
         for (auto port : receiver_ports) {
-            auto socket = new zmq::socket_t(context, ZMQ_PULL);
-            char address[32] = "";
-            snprintf(address, 32, "tcp://%s:%d", src_addr.c_str(), port);
-            std::cout << "Try to bind on:" << address << std::endl;
-            socket->bind(address);
-            std::cout << "Bind on address:" << address << std::endl;
-            receivers.push_back(socket);
+            if (transport_of(port) == TRANSPORT_SHM)
+                receivers.emplace_back(new ShmRecvChannel(src_addr, port));
+            else
+                receivers.emplace_back(new ZmqRecvChannel(context, transport_of(port), src_addr, port));
         }
+        init_poll();
     }
 
     ~MessageReceiver() {
@@ -60,31 +99,19 @@ public:
         // std::this_thread::sleep_for(std::chrono::seconds(1));
     }
 
+    // the new ports must use the same transports, in the same order
     void reset_port(std::vector<int> new_ports) {
         assert(new_ports.size() == ports.size());
         for(int idx = 0; idx < ports.size(); idx++) {
-            int port = ports[idx];
-            auto& socket = receivers[idx];
-            if (socket) {
-                char address[32] = "";
-                snprintf(address, 32, "tcp://%s:%d", src_addr.c_str(), port);
-                socket->unbind(address);
-                std::cout << "Unbind from address:" << address << std::endl;
-            }
+            receivers[idx]->unbind();
         }
 
         std::this_thread::sleep_for(std::chrono::seconds(1));
 
         for(int idx = 0; idx < new_ports.size(); idx++) {
-            int new_port = new_ports[idx];
-            auto& socket = receivers[idx];
-            if (socket) {
-                char address[32] = "";
-                snprintf(address, 32, "tcp://%s:%d", src_addr.c_str(), new_port);
-                socket->bind(address);
-                std::cout << "Bind on address:" << address << std::endl;
-            }
+            receivers[idx]->bind(new_ports[idx]);
         }
+        init_poll();
 
         ports.swap(new_ports);
     }
@@ -112,12 +139,60 @@ public:
     }
 
 
+    // zero-copy receive into frame (its previous message is released),
+    // read it with MsgView(frame.data(), frame.size())
+    bool tryrecv(RecvFrame &frame) {
+        for(size_t idx = 0; idx < ports.size(); idx++) {
+            if (receivers[(idx+offset) % ports.size()]->tryrecv(frame)) {
+                return true;
+            }
+        }
+        offset = (offset + 1) % ports.size();
+        return false;
+    }
+
+    // event-driven receive: wait up to timeout_ms for any channel to become readable
+    // (zmq_poll over the sockets, the doorbell futexes of the shm rings),
+    // then receive every message already queued on each ready channel into frame and call f(frame).
+    // returns the number of messages handled, 0 on timeout
+    template <class F>
+    size_t poll_drain(RecvFrame &frame, F&& f, long timeout_ms) {
+        // the ring of a message still held by frame would look readable
+        frame.release();
+
+        size_t cnt = 0;
+        if (shm_rings.empty()) {
+            // an error (e.g. EINTR, or ETERM at shutdown) counts as a timeout
+            if (zmq_poll(poll_items.data(), poll_items.size(), timeout_ms) <= 0)
+                return 0;
+            for(size_t idx = 0; idx < poll_items.size(); idx++) {
+                if (poll_items[idx].revents & ZMQ_POLLIN)
+                    cnt += drain(poll_receivers[idx], frame, f);
+            }
+            return cnt;
+        }
+
+        if (poll_items.empty()) {
+            ShmRing::wait_any(shm_rings, timeout_ms);
+        } else {
+            bool ready = false;
+            for (auto ring : shm_rings)
+                ready |= !ring->empty();
+            if (!ready)
+                zmq_poll(poll_items.data(), poll_items.size(), std::min(timeout_ms, MIXED_POLL_SLICE_MS));
+        }
+        for(size_t idx = 0; idx < receivers.size(); idx++) {
+            cnt += drain(idx, frame, f);
+        }
+        return cnt;
+    }
+
     bool tryrecv(int idx, std::string &str) {
-        zmq::message_t msg;
+        RecvFrame frame;
         bool success = false;
 
-        if (success = receivers[idx]->recv(&msg, ZMQ_NOBLOCK))
-            str = std::string((char *)msg.data(), msg.size());
+        if (success = receivers[idx]->tryrecv(frame))
+            str = std::string((const char *)frame.data(), frame.size());
 
         return success;
     }
@@ -6,6 +6,7 @@
 #include <errno.h>
 #include <pthread.h>
 #include <iostream>
+#include <memory>
 #include <unordered_map>
 #include <string>
 #include <fstream>
@@ -13,6 +14,9 @@
 #include <chrono>
 
 #include "common/config.h"
+#include "network/msg_buffer.hpp"
+#include "network/shm_transport.h"
+#include "network/zmq_transport.h"
 
 // utils
 #include "utils/logger2.hpp"
@@ -22,77 +26,33 @@ namespace ubiquant {
 
 extern volatile bool after_reset;
 
+// sending end of a channel, over the transport the network config gives its port pair
 class MessageSender {
 private:
-    zmq::context_t context;
-    std::string src_addr;
-    std::string dst_addr;
-    std::pair<int, int> channel;
-    zmq::socket_t* sender;
-
-    pthread_spinlock_t *send_locks;
-
-    bool connected = false;
+    std::unique_ptr<SendChannel> channel;
 
 public:
-    MessageSender(std::string my_addr, std::string receiver_addr, std::pair<int, int> port_pair) 
-        : context(1), src_addr(my_addr), dst_addr(receiver_addr), channel(port_pair) {
-        // new socket
-        sender = new zmq::socket_t(context, ZMQ_PUSH);
-    }
-
-    ~MessageSender() {
-        // if (sender) {
-        //     delete sender;
-        // }
+    MessageSender(std::string my_addr, std::string receiver_addr, std::pair<int, int> port_pair) {
+        if (transport_of(port_pair.second) == TRANSPORT_SHM)
+            channel.reset(new ShmSendChannel(receiver_addr, port_pair));
+        else
+            channel.reset(new ZmqSendChannel(transport_of(port_pair.second), my_addr, receiver_addr, port_pair));
     }
 
+    // the new port pair must use the same transport
     void reset_port(std::pair<int, int> port_pair) {
-        char address[64] = "";
-        //snprintf(address, 32, "tcp://%s:%d", dst_addr.c_str(), channel.second);
-        snprintf(address, 64, "tcp://%s:%d;%s:%d", 
-                 src_addr.c_str(), 
-                 channel.first, 
-                 dst_addr.c_str(), 
-                 channel.second);
-        sender->disconnect(address);
-
-        connected = false;
-
-        // set new channel
-        channel = port_pair;
+        channel->reset_port(port_pair);
     }
 
     bool send(const std::string &str) {
-        zmq::message_t msg(str.length());
-        memcpy((void *)msg.data(), str.c_str(), str.length());
-
-        if (!connected) {
-            // connect on-demand
-            char address[64] = "";
-            //snprintf(address, 32, "tcp://%s:%d", dst_addr.c_str(), channel.second);
-            snprintf(address, 64, "tcp://%s:%d;%s:%d", 
-                 src_addr.c_str(), 
-                 channel.first, 
-                 dst_addr.c_str(), 
-                 channel.second);
-            std::cout << "Tring to Connect to " << address << std::endl;
-            sender->connect(address);
-            std::cout << "Connect to " << address << std::endl;
-
-            connected = true;
-        }
-
-        // TODO: use two channels
-        bool result = sender->send(msg, ZMQ_DONTWAIT);
-        // if (!result) {
-        //     logstream(LOG_INFO) << "failed to send msg to ["
-        //                          << dst_addr << ":" << channels[0].second << "] "
-        //                          << strerror(errno) << LOG_endl;
-        // }
+        return channel->send(str.c_str(), str.length());
+    }
 
-        return result;
+    // the caller keeps its own reference of buf either way, and retries with the same buffer on failure
+    // (zero-copy over ZMQ, copied once into the ring over shm)
+    bool send(MsgBuffer* buf) {
+        return channel->send(buf);
     }
 };
 
-} // namespace ubiquant
\ No newline at end of file
+} // namespace ubiquant
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+#include "utils/assertion.hpp"
+
+#ifndef SYS_futex_waitv
+#define SYS_futex_waitv 449
+#endif
+
+namespace ubiquant {
+
+/**
+ * Single-producer single-consumer ring of framed messages in a POSIX shared-memory segment,
+ * one per channel of a co-located trader and exchange, named after the receiving endpoint.
+ *
+ * A message is a record {uint32 len, uint32 pad, len bytes} padded to 8 bytes; a record that would
+ * cross the end of the ring is preceded by a WRAP record filling the rest. The producer publishes
+ * records by moving tail (release), the consumer reads them in place and frees them by moving head.
+ * Both positions live in the segment, so a restarted producer continues where the last one stopped.
+ *
+ * A consumer about to sleep sets waiting and waits on the doorbell futex (shared, not private),
+ * the producer rings the doorbell after publishing only when waiting is set.
+ */
+class ShmRing {
+public:
+    constexpr static size_t HEADER_SIZE = 4096;
+
+    // segment of the channel received on addr:port
+    static std::string name_of(const std::string& addr, int port) {
+        return "/ubiquant-" + addr + "-" + std::to_string(port);
+    }
+
+    // ring bytes of a new segment (config: shm_ring_mb), rounded up to a power of two
+    static size_t default_capacity() {
+        size_t cap = 1;
+        while (cap < ((size_t)Config::shm_ring_mb << 20)) cap <<= 1;
+        return cap;
+    }
+
+    // map the segment of name, created with a ring of capacity bytes if it does not exist yet
+    ShmRing(const std::string& name, size_t capacity) : name_(name) {
+        int fd = shm_open(name_.c_str(), O_CREAT | O_RDWR, 0600);
+        if (fd < 0)
+            throw std::runtime_error("shm_open " + name_ + " error.");
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (st.st_size == 0 && ftruncate(fd, HEADER_SIZE + capacity) != 0) || fstat(fd, &st) != 0)
+            throw std::runtime_error("ftruncate " + name_ + " error.");
+
+        // an existing segment keeps its size, whoever created it
+        size_ = st.st_size;
+        capacity_ = size_ - HEADER_SIZE;
+        ASSERT_MSG(capacity_ > 0 && (capacity_ & (capacity_ - 1)) == 0, "shm ring capacity must be a power of two");
+        mask_ = capacity_ - 1;
+
+        void* addr = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED)
+            throw std::runtime_error("mmap " + name_ + " error.");
+        base_ = (char*)addr;
+    }
+
+    ~ShmRing() { munmap(base_, size_); }
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    inline const std::string& name() const { return name_; }
+
+    /* producer */
+
+    // copy a message into the ring, false if it is full
+    bool try_write(const void* data, size_t len) {
+        const uint64_t need = record_bytes(len);
+        ASSERT_MSG(need <= capacity_ / 2, "message larger than half of the shm ring, raise shm_ring_mb");
+
+        Header* h = header();
+        uint64_t tail = h->tail.load(std::memory_order_relaxed);
+        uint64_t head = h->head.load(std::memory_order_acquire);
+        uint64_t to_end = capacity_ - (tail & mask_);
+        uint64_t skip = (to_end < need) ? to_end : 0;
+        if (tail + skip + need - head > capacity_)
+            return false;
+
+        if (skip != 0) {
+            record_at(tail)->len = WRAP;
+            tail += skip;
+        }
+        Record* r = record_at(tail);
+        r->len = (uint32_t)len;
+        memcpy((void*)(r + 1), data, len);
+        h->tail.store(tail + need, std::memory_order_release);
+
+        // pairs with the fence of a consumer going to sleep
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (h->waiting.load(std::memory_order_relaxed)) {
+            h->doorbell.fetch_add(1, std::memory_order_release);
+            syscall(SYS_futex, (uint32_t*)&h->doorbell, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+        }
+        return true;
+    }
+
+    // whether a live process is bound as the consumer
+    bool receiver_alive() const {
+        int pid = header()->receiver_pid.load(std::memory_order_acquire);
+        return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+    }
+
+    /* consumer */
+
+    // become the consumer: drop whatever a previous consumer left, like a freshly bound socket
+    void bind() {
+        Header* h = header();
+        h->receiver_pid.store(0, std::memory_order_release);
+        h->head.store(h->tail.load(std::memory_order_acquire), std::memory_order_release);
+        h->receiver_pid.store(getpid(), std::memory_order_release);
+    }
+
+    void unbind() {
+        header()->receiver_pid.store(0, std::memory_order_release);
+    }
+
+    // the record at head, read in place until release(next)
+    bool peek(const char*& data, size_t& len, uint64_t& next) {
+        Header* h = header();
+        uint64_t head = h->head.load(std::memory_order_relaxed);
+        uint64_t tail = h->tail.load(std::memory_order_acquire);
+        if (head == tail)
+            return false;
+
+        Record* r = record_at(head);
+        if (r->len == WRAP) {
+            head += capacity_ - (head & mask_);
+            h->head.store(head, std::memory_order_release);
+            if (head == tail)
+                return false;
+            r = record_at(head);
+        }
+        data = (const char*)(r + 1);
+        len = r->len;
+        next = head + record_bytes(len);
+        return true;
+    }
+
+    inline void release(uint64_t next) {
+        header()->head.store(next, std::memory_order_release);
+    }
+
+    inline bool empty() const {
+        const Header* h = header();
+        return h->head.load(std::memory_order_relaxed) == h->tail.load(std::memory_order_acquire);
+    }
+
+    // consumer of all the rings: sleep until one of them has a record, at most timeout_ms
+    static void wait_any(const std::vector<ShmRing*>& rings, long timeout_ms) {
+        // struct futex_waitv of linux/futex.h (5.16+), FUTEX2_SIZE_U32 and shared
+        struct Waiter {
+            uint64_t val;
+            uint64_t uaddr;
+            uint32_t flags;
+            uint32_t reserved;
+        };
+        constexpr size_t MAX_WAITERS = 128;
+        Waiter waiters[MAX_WAITERS];
+        size_t n = std::min(rings.size(), MAX_WAITERS);
+        for (size_t i = 0; i < n; i++) {
+            Header* h = rings[i]->header();
+            waiters[i] = {h->doorbell.load(std::memory_order_acquire), (uint64_t)(uintptr_t)&h->doorbell, 0x02, 0};
+            h->waiting.store(1, std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        bool ready = false;
+        for (auto ring : rings)
+            ready |= !ring->empty();
+        if (!ready) {
+            bool waited = false;
+            if (n == rings.size()) {
+                struct timespec deadline;
+                clock_gettime(CLOCK_MONOTONIC, &deadline);
+                deadline.tv_sec += timeout_ms / 1000;
+                deadline.tv_nsec += (timeout_ms % 1000) * 1000000;
+                if (deadline.tv_nsec >= 1000000000) {
+                    deadline.tv_sec++;
+                    deadline.tv_nsec -= 1000000000;
+                }
+                waited = syscall(SYS_futex_waitv, waiters, n, 0, &deadline, CLOCK_MONOTONIC) >= 0 || errno != ENOSYS;
+            }
+            if (!waited) {
+                // no futex_waitv (or too many rings): wait on the first ring only, in short slices
+                struct timespec ts = {0, std::min(timeout_ms, 1l) * 1000000};
+                syscall(SYS_futex, (uint32_t*)&rings[0]->header()->doorbell, FUTEX_WAIT, (uint32_t)waiters[0].val, &ts, nullptr, 0);
+            }
+        }
+
+        for (auto ring : rings)
+            ring->header()->waiting.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    constexpr static uint32_t WRAP = UINT32_MAX;
+
+    struct Header {
+        std::atomic<int32_t> receiver_pid;
+        alignas(64) std::atomic<uint64_t> tail;
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint32_t> doorbell;
+        std::atomic<uint32_t> waiting;
+    };
+    static_assert(sizeof(Header) <= HEADER_SIZE, "shm ring header too large");
+
+    struct Record {
+        uint32_t len;
+        uint32_t pad;
+    };
+
+    static inline uint64_t record_bytes(size_t len) { return (sizeof(Record) + len + 7) & ~7ul; }
+
+    inline Header* header() const { return (Header*)base_; }
+    inline Record* record_at(uint64_t pos) const { return (Record*)(base_ + HEADER_SIZE + (pos & mask_)); }
+
+    std::string name_;
+    char* base_ = nullptr;
+    size_t size_ = 0;
+    uint64_t capacity_ = 0;
+    uint64_t mask_ = 0;
+};
+
+}  // namespace ubiquant
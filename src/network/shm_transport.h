@@ -0,0 +1,98 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "network/transport.h"
+
+namespace ubiquant {
+
+/**
+ * A channel through the ShmRing of the receiving endpoint, mapped on the first send.
+ * Like a ZMQ connect before the bind, messages wait until a live receiver is bound on the ring;
+ * a message is copied into the ring once, the receiver reads it there without another copy.
+ */
+class ShmSendChannel : public SendChannel {
+private:
+    constexpr static int RECEIVER_RETRY_US = 100;
+
+    std::string dst_addr;
+    std::pair<int, int> channel;
+    std::unique_ptr<ShmRing> ring;
+    bool bound = false;
+
+public:
+    ShmSendChannel(std::string receiver_addr, std::pair<int, int> port_pair)
+        : dst_addr(receiver_addr), channel(port_pair) {}
+
+    void reset_port(std::pair<int, int> port_pair) override {
+        ring.reset();
+        bound = false;
+        channel = port_pair;
+    }
+
+    bool send(const void* data, size_t size) override {
+        if (!ring) {
+            ring.reset(new ShmRing(ShmRing::name_of(dst_addr, channel.second), ShmRing::default_capacity()));
+            std::cout << "Map shm ring " << ring->name() << std::endl;
+        }
+        if (!bound) {
+            // a ring left by an earlier run, the receiver has not started yet
+            if (!ring->receiver_alive()) {
+                usleep(RECEIVER_RETRY_US);
+                return false;
+            }
+            bound = true;
+        }
+        return ring->try_write(data, size);
+    }
+
+    // the ring keeps a copy, buf stays with the caller
+    bool send(MsgBuffer* buf) override {
+        return send(buf->data(), buf->size());
+    }
+};
+
+// a channel through the ShmRing of src_addr:port, of which this process is the only consumer
+class ShmRecvChannel : public RecvChannel {
+private:
+    std::string src_addr;
+    std::shared_ptr<ShmRing> ring_;
+    // rings unbound by a reset, a paused receiver may still hold a frame into them
+    std::vector<std::shared_ptr<ShmRing>> retired_;
+
+public:
+    ShmRecvChannel(std::string my_addr, int recv_port) : src_addr(my_addr) {
+        bind(recv_port);
+    }
+
+    int transport() const override { return TRANSPORT_SHM; }
+
+    inline ShmRing* ring() { return ring_.get(); }
+
+    void unbind() override {
+        ring_->unbind();
+        std::cout << "Unbind from shm ring " << ring_->name() << std::endl;
+        retired_.push_back(ring_);
+    }
+
+    void bind(int new_port) override {
+        ring_ = std::make_shared<ShmRing>(ShmRing::name_of(src_addr, new_port), ShmRing::default_capacity());
+        ring_->bind();
+        std::cout << "Bind on shm ring " << ring_->name() << std::endl;
+    }
+
+    bool tryrecv(RecvFrame& frame) override {
+        frame.release();
+        if (!ring_->peek(frame.shm_data_, frame.shm_size_, frame.shm_next_))
+            return false;
+        frame.ring_ = ring_.get();
+        return true;
+    }
+};
+
+}  // namespace ubiquant
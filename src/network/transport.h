@@ -0,0 +1,99 @@
+#pragma once
+
+#include <zmq.hpp>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "common/config.h"
+#include "network/msg_buffer.hpp"
+#include "network/shm_ring.hpp"
+
+namespace ubiquant {
+
+// transport of a channel, chosen per port pair in the network config (see load_port_pair)
+enum TRANSPORT {
+    TRANSPORT_TCP = 0,  // ZMQ PUSH/PULL over TCP
+    TRANSPORT_SHM = 1,  // ShmRing, trader and exchange on the same host
+    TRANSPORT_INPROC = 2,  // ZMQ PUSH/PULL within one process, all channels (see Config::inproc_transport)
+};
+
+inline int transport_of(int port) {
+    if (Config::inproc_transport)
+        return TRANSPORT_INPROC;
+    return Config::shm_ports.count(port) ? TRANSPORT_SHM : TRANSPORT_TCP;
+}
+
+// both ends of an inproc channel must share a context, so there is one for the process
+// (never terminated: a zmq_ctx_term at exit would wait for the sockets still open)
+inline zmq::context_t& inproc_context() {
+    static zmq::context_t* context = new zmq::context_t(1);
+    return *context;
+}
+
+/**
+ * A received message, read in place with MsgView(frame.data(), frame.size()).
+ * It stays valid until the frame receives the next message or is released:
+ * a ZMQ frame owns its message, a shm frame points into the ring and frees the record on release.
+ */
+class RecvFrame {
+public:
+    RecvFrame() = default;
+    ~RecvFrame() { release(); }
+
+    RecvFrame(const RecvFrame&) = delete;
+    RecvFrame& operator=(const RecvFrame&) = delete;
+
+    inline const void* data() { return ring_ ? shm_data_ : zmq_frame_.data(); }
+    inline size_t size() { return ring_ ? shm_size_ : zmq_frame_.size(); }
+
+    // hand a shm record back to its ring (a ZMQ frame is replaced by the next recv)
+    inline void release() {
+        if (ring_) {
+            ring_->release(shm_next_);
+            ring_ = nullptr;
+        }
+    }
+
+private:
+    friend class ZmqRecvChannel;
+    friend class ShmRecvChannel;
+
+    zmq::message_t zmq_frame_;
+
+    ShmRing* ring_ = nullptr;
+    const char* shm_data_ = nullptr;
+    size_t shm_size_ = 0;
+    uint64_t shm_next_ = 0;
+};
+
+// sending end of a channel
+class SendChannel {
+public:
+    virtual ~SendChannel() {}
+
+    // the caller keeps its reference of buf and retries with the same buffer on failure
+    virtual bool send(MsgBuffer* buf) = 0;
+    virtual bool send(const void* data, size_t size) = 0;
+
+    // switch to another port pair of the same transport
+    virtual void reset_port(std::pair<int, int> port_pair) = 0;
+};
+
+// receiving end of a channel
+class RecvChannel {
+public:
+    virtual ~RecvChannel() {}
+
+    virtual int transport() const = 0;
+
+    // non-blocking, frame's previous message is released first
+    virtual bool tryrecv(RecvFrame& frame) = 0;
+
+    // reset: unbind from the current port, then bind on another one of the same transport
+    virtual void unbind() = 0;
+    virtual void bind(int new_port) = 0;
+};
+
+}  // namespace ubiquant
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <zmq.hpp>
+#include <string.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "network/transport.h"
+
+namespace ubiquant {
+
+// a channel over a ZMQ PUSH socket, connected on the first send
+class ZmqSendChannel : public SendChannel {
+private:
+    std::unique_ptr<zmq::context_t> context;    // TCP only, inproc shares inproc_context()
+    int transport;
+    std::string src_addr;
+    std::string dst_addr;
+    std::pair<int, int> channel;
+    zmq::socket_t* sender;
+
+    bool connected = false;
+
+    void address(char* address, size_t len) {
+        if (transport == TRANSPORT_INPROC) {
+            snprintf(address, len, "inproc://%s:%d", dst_addr.c_str(), channel.second);
+            return;
+        }
+        //snprintf(address, 32, "tcp://%s:%d", dst_addr.c_str(), channel.second);
+        snprintf(address, len, "tcp://%s:%d;%s:%d",
+                 src_addr.c_str(),
+                 channel.first,
+                 dst_addr.c_str(),
+                 channel.second);
+    }
+
+public:
+    ZmqSendChannel(int transport, std::string my_addr, std::string receiver_addr, std::pair<int, int> port_pair)
+        : transport(transport), src_addr(my_addr), dst_addr(receiver_addr), channel(port_pair) {
+        if (transport != TRANSPORT_INPROC)
+            context.reset(new zmq::context_t(1));
+        // new socket
+        sender = new zmq::socket_t(context ? *context : inproc_context(), ZMQ_PUSH);
+    }
+
+    void reset_port(std::pair<int, int> port_pair) override {
+        char address[64] = "";
+        this->address(address, 64);
+        sender->disconnect(address);
+        connected = false;
+
+        // set new channel
+        channel = port_pair;
+    }
+
+    bool send(const void* data, size_t size) override {
+        zmq::message_t msg(size);
+        memcpy((void *)msg.data(), data, size);
+        return send(msg);
+    }
+
+    // zero-copy send: the frame points into buf, which keeps a reference until ZMQ has written it
+    bool send(MsgBuffer* buf) override {
+        buf->retain();
+        zmq::message_t msg(buf->data(), buf->size(), release_buffer, buf);
+        // a failed send closes msg, which drops the reference taken above
+        return send(msg);
+    }
+
+private:
+    static void release_buffer(void* data, void* hint) {
+        ((MsgBuffer*)hint)->release();
+    }
+
+    bool send(zmq::message_t &msg) {
+        if (!connected) {
+            // connect on-demand
+            char address[64] = "";
+            this->address(address, 64);
+            std::cout << "Tring to Connect to " << address << std::endl;
+            sender->connect(address);
+            std::cout << "Connect to " << address << std::endl;
+
+            connected = true;
+        }
+
+        bool result = sender->send(msg, ZMQ_DONTWAIT);
+        // if (!result) {
+        //     logstream(LOG_INFO) << "failed to send msg to ["
+        //                          << dst_addr << ":" << channels[0].second << "] "
+        //                          << strerror(errno) << LOG_endl;
+        // }
+
+        return result;
+    }
+};
+
+// a channel over a ZMQ PULL socket bound on src_addr:port, sharing the context of its MessageReceiver (TCP)
+// or inproc_context()
+class ZmqRecvChannel : public RecvChannel {
+private:
+    int transport_;
+    std::string src_addr;
+    int port;
+    zmq::socket_t* receiver;
+
+    void address(char* address, size_t len) {
+        snprintf(address, len, "%s://%s:%d", transport_ == TRANSPORT_INPROC ? "inproc" : "tcp", src_addr.c_str(), port);
+    }
+
+public:
+    ZmqRecvChannel(zmq::context_t& context, int transport, std::string my_addr, int recv_port)
+        : transport_(transport), src_addr(my_addr), port(recv_port) {
+        receiver = new zmq::socket_t(transport == TRANSPORT_INPROC ? inproc_context() : context, ZMQ_PULL);
+        char address[64] = "";
+        this->address(address, 64);
+        std::cout << "Try to bind on:" << address << std::endl;
+        receiver->bind(address);
+        std::cout << "Bind on address:" << address << std::endl;
+    }
+
+    int transport() const override { return transport_; }
+
+    inline zmq::socket_t* socket() { return receiver; }
+
+    void unbind() override {
+        char address[64] = "";
+        this->address(address, 64);
+        receiver->unbind(address);
+        std::cout << "Unbind from address:" << address << std::endl;
+    }
+
+    void bind(int new_port) override {
+        port = new_port;
+        char address[64] = "";
+        this->address(address, 64);
+        receiver->bind(address);
+        std::cout << "Bind on address:" << address << std::endl;
+    }
+
+    bool tryrecv(RecvFrame& frame) override {
+        frame.release();
+        return receiver->recv(&frame.zmq_frame_, ZMQ_NOBLOCK);
+    }
+};
+
+}  // namespace ubiquant
@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <vector>
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <mutex>
+#include <signal.h>
+
+#include "common/console.hpp"
+#include "common/huge_page.hpp"
+#include "common/monitor.hpp"
+#include "common/topology.hpp"
+
+#include "exchange/ack_sender.h"
+#include "exchange/order_receiver.h"
+#include "exchange/trade_sender.h"
+#include "exchange/exchange.h"
+#include "exchange/snapshot_writer.h"
+
+#include "trader/trader_controller.h"
+
+#include "utils/timer.hpp"
+#include "utils/util.h"
+
+/**
+ * All traders and exchanges in one process: node p (partition p) is trader p and exchange p,
+ * configured by the p-th config file as if they ran alone. The threads of a node see its config
+ * items and its Global instances (see NodeConfig), the channels between nodes are ZMQ inproc sockets.
+ * The console commands apply to every node.
+ */
+namespace ubiquant {
+
+volatile bool work_flag = true;
+volatile bool after_reset = false;
+
+inline bool at_work() { return work_flag; }
+
+inline void finish_work() { work_flag = false; }
+
+std::vector<NodeConfig> nodes;
+
+// run f(p) as node p for every exchange, then every trader
+template <class F>
+void for_each_exchange(F&& f) {
+  for (int p = 0; p < Config::exchange_num; p++) {
+    nodes[p].install();
+    f(p);
+  }
+  nodes[0].install();
+}
+
+template <class F>
+void for_each_trader(F&& f) {
+  for (int p = 0; p < Config::trader_num; p++) {
+    nodes[p].install();
+    f(p);
+  }
+  nodes[0].install();
+}
+
+void stop_network_sender() {
+  for_each_trader([](int p) {
+    Global<TraderController>::Get()->stop_sender();
+    std::cout << "Stop Trader-Senders-" << p << std::endl;
+  });
+  for_each_exchange([](int p) {
+    Global<ExchangeTradeSender>::Get()->stop();
+    Global<ExchangeAckSender>::Get()->stop();
+    std::cout << "Stop Exchange-Senders-" << p << std::endl;
+  });
+}
+
+void stop_network_receiver() {
+  for_each_trader([](int p) {
+    Global<TraderController>::Get()->stop_receiver();
+    std::cout << "Stop Trader-Receivers-" << p << std::endl;
+  });
+  for_each_exchange([](int p) {
+    Global<ExchangeOrderReceiver>::Get()->stop();
+    std::cout << "Stop Exchange-Receivers-" << p << std::endl;
+  });
+}
+
+void restart_network() {
+  for_each_exchange([](int p) {
+    Global<ExchangeOrderReceiver>::Get()->restart();
+    Global<ExchangeTradeSender>::Get()->restart();
+    Global<ExchangeAckSender>::Get()->restart();
+    std::cout << "Restart Exchange-" << p << std::endl;
+  });
+  for_each_trader([](int p) {
+    Global<TraderController>::Get()->restart();
+    std::cout << "Restart Trader-" << p << std::endl;
+  });
+}
+
+void reset_network() {
+  for_each_exchange([](int p) {
+    Global<ExchangeOrderReceiver>::Get()->reset_network();
+    Global<ExchangeTradeSender>::Get()->reset_network();
+    Global<ExchangeAckSender>::Get()->reset_network();
+    std::cout << "Reset Exchange-" << p << std::endl;
+  });
+  for_each_trader([](int p) {
+    Global<TraderController>::Get()->reset_network();
+    std::cout << "Reset Trader-" << p << std::endl;
+  });
+}
+
+void exit_system() {
+  // traders first, they flush their trades
+  for_each_trader([](int p) {
+    Global<TraderController>::Delete();
+  });
+  for_each_exchange([](int p) {
+    Global<ExchangeOrderReceiver>::Delete();
+    Global<ExchangeTradeSender>::Delete();
+    Global<ExchangeAckSender>::Delete();
+    Global<Exchange>::Delete();
+    Global<ExchangeSnapshotWriter>::Delete();
+  });
+  // the nodes share one log buffer
+  for (int p = 1; p < (int)nodes.size(); p++) {
+    nodes[p].install();
+    Global<LogBuffer>::SetAllocated(nullptr);
+  }
+  nodes[0].install();
+  Global<LogBuffer>::Delete();
+}
+
+}
+
+namespace {
+
+std::mutex exit_lock;  // race between two signals
+
+void printTraceExit(int sig) {
+  ubiquant::print_stacktrace();
+}
+
+void sigsegv_handler(int sig) {
+  std::lock_guard<std::mutex> lock(exit_lock);
+  fprintf(stderr, "[Pipeline] Meet a segmentation fault!\n");
+  // printTraceExit(sig);
+  ubiquant::work_flag = false;
+  exit(-1);
+}
+
+void sigint_handler(int sig) {
+  std::lock_guard<std::mutex> lock(exit_lock);
+  fprintf(stderr, "[Pipeline] Meet an interrupt!\n");
+  // printTraceExit(sig);
+  ubiquant::work_flag = false;
+  exit(-1);
+}
+
+void sigabrt_handler(int sig) {
+  std::lock_guard<std::mutex> lock(exit_lock);
+  fprintf(stderr, "[Pipeline] Meet an assertion failure!\n");
+  printTraceExit(sig);
+  exit(-1);
+}
+
+} // anonymous namespace
+
+using namespace ubiquant;
+
+int main(int argc, char *argv[])
+{
+    /* install the event handler if necessary */
+    signal(SIGSEGV, sigsegv_handler);
+    signal(SIGABRT, sigabrt_handler);
+    signal(SIGINT,  sigint_handler);
+
+    /* parse command arguments */
+    if (argc < 3) {
+        std::cout << "Usage: ./pipeline_local load_mode config_file0 [config_file1]" << std::endl;
+        return 0;
+    }
+    Config::load_mode = std::stoi(std::string(argv[1]));
+
+    /* load config files, one per node, the shared items should agree */
+    for (int p = 0; p < argc - 2; p++) {
+        NodeConfig node;
+        node.partition_idx = p;
+        node.install();
+        load_config(std::string(argv[p + 2]));
+        nodes.push_back(NodeConfig::current());
+    }
+    ASSERT_MSG((int)nodes.size() == std::max(Config::trader_num, Config::exchange_num),
+               "one config file per partition!");
+    ASSERT_MSG((int)nodes.size() <= MAX_PARTITIONS, "partition_idx can only be 0 or 1!");
+    Config::inproc_transport = 1;
+
+    for (auto& node : nodes) {
+        node.install();
+        std::cout << "Trader[" << Config::partition_idx << "] and Exchange[" << Config::partition_idx << "] are starting..." << std::endl;
+        print_config();
+    }
+    CpuTopology::get().print();
+
+    nodes[0].install();
+    LogBuffer* log_buffer = Global<LogBuffer>::New();
+    for (auto& node : nodes) {
+        node.install();
+        Global<LogBuffer>::SetAllocated(log_buffer);
+    }
+
+    // the exchanges load before any trader, both may update the cache file names of a partition (see init_loader)
+    for_each_exchange([](int p) {
+        Global<ExchangeOrderReceiver>::New();
+        Global<ExchangeTradeSender>::New();
+        Global<ExchangeAckSender>::New();
+        Global<ExchangeSnapshotWriter>::New();
+        Global<Exchange>::New();
+        HugePages::get().report("Exchange[" + std::to_string(p) + "]");
+
+        Global<ExchangeTradeSender>::Get()->start();
+        Global<ExchangeAckSender>::Get()->start();
+        Global<ExchangeSnapshotWriter>::Get()->start();
+        Global<ExchangeOrderReceiver>::Get()->start();
+        Global<Exchange>::Get()->start();
+    });
+
+    for_each_trader([](int p) {
+        Global<TraderController>::New();
+        Global<TraderController>::Get()->start();
+    });
+
+    run_console("Pipeline");
+
+    return 0;
+}
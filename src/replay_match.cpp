@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/config.h"
+#include "common/loader.hpp"
+#include "common/type.hpp"
+#include "exchange/stock_exchange.h"
+#include "utils/timer.hpp"
+
+/*
+ * Offline batch matcher: replays the sorted order caches (load_mode 0) of both traders
+ * through one StockExchange per stock, without any networking.
+ * The trader-side rules (hook and price limit, see TraderController::check_order) are applied here,
+ * so trade_res.* are byte-identical to those of a distributed run.
+ */
+
+namespace ubiquant {
+
+volatile bool work_flag = true;
+volatile bool after_reset = false;
+
+// hook state shared by the replay threads of all stocks
+struct ReplayHooks {
+    std::vector<std::unordered_map<order_id_t, HookTarget>> hook;
+    std::shared_ptr<std::vector<std::unordered_map<trade_idx_t, volume_t>>> hooked_trade;
+
+    // number of trades of each stock whose hooked volume is published
+    std::unique_ptr<std::atomic<int>[]> trade_cnt;
+    std::unique_ptr<std::atomic<bool>[]> finished;
+
+    ReplayHooks() {
+        std::tie(hook, hooked_trade) = load_hook();
+        trade_cnt.reset(new std::atomic<int>[Config::stock_num]);
+        finished.reset(new std::atomic<bool>[Config::stock_num]);
+        for (int t = 0; t < Config::stock_num; t++) {
+            trade_cnt[t].store(0);
+            finished[t].store(false);
+        }
+    }
+
+    // block until the target trade is produced, like the trader waiting for the hooked trade
+    volume_t wait_hooked_volume(const HookTarget& ht) {
+        int t = ht.target_stk_code - 1;
+        while (trade_cnt[t].load(std::memory_order_acquire) < ht.target_trade_idx) {
+            if (finished[t].load(std::memory_order_acquire)) {
+                ASSERT_MSG(trade_cnt[t].load(std::memory_order_acquire) >= ht.target_trade_idx, "hooked trade is never produced!");
+                break;
+            }
+            std::this_thread::yield();
+        }
+        return (*hooked_trade)[t].at(ht.target_trade_idx);
+    }
+};
+
+class ReplayStock : public ubi_thread {
+   public:
+    ReplayStock(int stk_code, std::vector<Order>&& orders, price_t lower_limit, price_t upper_limit, ReplayHooks& hooks)
+        : stk_code(stk_code), orders(std::move(orders)), exchange(stk_code, lower_limit, upper_limit), hooks(hooks) {}
+
+    void run() override {
+        auto& hook = hooks.hook[stk_code - 1];
+        auto& hooked = (*hooks.hooked_trade)[stk_code - 1];
+        auto& trades = exchange.getTradeBatch();
+        int trade_idx = 0;
+
+        uint64_t start = timer::get_usec();
+        for (Order& order : orders) {
+            auto it = hook.find(order.order_id);
+            if (it != hook.end() && hooks.wait_hooked_volume(it->second) > it->second.arg)
+                order.type = -1;  // constraint is not met, abandon hook order
+
+            exchange.receiveOrder(order);
+            if (trades.empty())
+                continue;
+
+            for (auto& trade : trades) {
+                auto hit = hooked.find(++trade_idx);
+                if (hit != hooked.end())
+                    hit->second = trade.volume;
+                output.push_back(convert_commtrade_to_trade(trade));
+            }
+            trades.clear();
+            hooks.trade_cnt[stk_code - 1].store(trade_idx, std::memory_order_release);
+        }
+        elapsed_usec = timer::get_usec() - start;
+        hooks.finished[stk_code - 1].store(true, std::memory_order_release);
+    }
+
+    void dump(const std::string& fname) const {
+        std::ofstream ofs(fname, std::ios::out | std::ios::binary);
+        ofs.write((const char*)output.data(), output.size() * sizeof(Trade));
+    }
+
+    inline size_t num_orders() const { return orders.size(); }
+    inline size_t num_trades() const { return output.size(); }
+    inline uint64_t get_elapsed_usec() const { return elapsed_usec; }
+
+   private:
+    int stk_code;
+    std::vector<Order> orders;
+    StockExchange exchange;
+    ReplayHooks& hooks;
+
+    std::vector<Trade> output;
+    uint64_t elapsed_usec = 0;
+};
+
+// merge the caches of both traders (each sorted by order id) into the full order stream of one stock
+std::vector<Order> load_stock_orders(int stk_code_minus_one, const std::vector<std::vector<price_t>> (&price_limits)[2]) {
+    std::vector<Order> parts[2];
+    for (int part = 0; part < 2; part++) {
+        parts[part] = load_cached_orders(part, stk_code_minus_one);
+        // abandon order if price exceed limits (limits of the trader owning the order)
+        for (Order& order : parts[part]) {
+            if (order.type == 0 && (order.price < price_limits[part][0][stk_code_minus_one] || order.price > price_limits[part][1][stk_code_minus_one]))
+                order.type = -1;
+        }
+    }
+
+    std::vector<Order> orders(parts[0].size() + parts[1].size());
+    std::merge(parts[0].begin(), parts[0].end(), parts[1].begin(), parts[1].end(), orders.begin(),
+               [](const Order& o1, const Order& o2) { return o1.order_id < o2.order_id; });
+    for (size_t i = 0; i < orders.size(); i++)
+        ASSERT_MSG(orders[i].order_id == (int)i + 1, "order ids of a stock should be dense!");
+    return orders;
+}
+
+// point the cache file names of one partition to another folder
+void set_cache_folder(int part, const std::string& folder) {
+    for (auto& fname : CACHE_FILE_NAME[part])
+        fname = folder + fname.substr(Config::trade_output_folder.size());
+}
+
+}  // namespace ubiquant
+
+using namespace ubiquant;
+
+int main(int argc, char* argv[]) {
+    /* parse command arguments */
+    if (argc != 2 && argc != 4) {
+        std::cout << "Usage: ./replay_match config_file [part0_cache_folder part1_cache_folder]" << std::endl;
+        return 0;
+    }
+
+    /* load config file */
+    load_config(std::string(argv[1]));
+    print_config();
+
+    init_loader();
+    if (argc == 4) {
+        set_cache_folder(0, argv[2]);
+        set_cache_folder(1, argv[3]);
+    }
+
+    std::vector<std::vector<price_t>> price_limits[2] = {load_prev_close(0), load_prev_close(1)};
+    ReplayHooks hooks;
+
+    uint64_t start = timer::get_usec();
+    std::vector<std::unique_ptr<ReplayStock>> stocks;
+    for (int t = 0; t < Config::stock_num; t++) {
+        // the price ladder is bounded by the limits the owning exchange loads
+        auto& ladder_limits = price_limits[(t + 1) % Config::exchange_num];
+        stocks.emplace_back(new ReplayStock(t + 1, load_stock_orders(t, price_limits), ladder_limits[0][t], ladder_limits[1][t], hooks));
+    }
+    std::cout << "Load order caches in " << (timer::get_usec() - start) / 1000 << " msec" << std::endl;
+
+    // one stock per core
+    start = timer::get_usec();
+    for (int t = 0; t < Config::stock_num; t++) {
+        stocks[t]->start();
+        if (2 * t < (int)std::thread::hardware_concurrency())
+            stocks[t]->binding(t);
+    }
+    for (auto& stock : stocks) {
+        stock->join();
+    }
+    uint64_t elapsed = timer::get_usec() - start;
+
+    size_t total_orders = 0;
+    for (int t = 0; t < Config::stock_num; t++) {
+        auto& stock = stocks[t];
+        stock->dump(Config::trade_output_folder + "/trade_res." + std::to_string(t + 1));
+        total_orders += stock->num_orders();
+        std::cout << "stock " << t + 1 << ": " << stock->num_orders() << " orders, " << stock->num_trades() << " trades in "
+                  << stock->get_elapsed_usec() / 1000 << " msec, "
+                  << (uint64_t)(stock->num_orders() * 1e6 / std::max<uint64_t>(stock->get_elapsed_usec(), 1)) << " orders/sec" << std::endl;
+    }
+    std::cout << "total: " << total_orders << " orders in " << elapsed / 1000 << " msec, "
+              << (uint64_t)(total_orders * 1e6 / std::max<uint64_t>(elapsed, 1)) << " orders/sec" << std::endl;
+
+    return 0;
+}
@@ -11,6 +11,7 @@
 #include "common/global.hpp"
 #include "common/config.h"
 #include "common/console.hpp"
+#include "common/topology.hpp"
 
 #include "trader/trader_controller.h"
 
@@ -113,6 +114,7 @@ int main(int argc, char *argv[]) {
 
     std::cout << "Trader[" << Config::partition_idx << "] is starting..." << std::endl;
     print_config();
+    CpuTopology::get().print();
 
     Global<LogBuffer>::New();
     Global<TraderController>::New();
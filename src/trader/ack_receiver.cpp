@@ -0,0 +1,83 @@
+#include "ack_receiver.h"
+
+#include "common/global.hpp"
+#include "trader_controller.h"
+
+namespace ubiquant {
+
+TraderAckReceiver::TraderAckReceiver() : waiter_(Config::recv_wait_strategy) {
+    // init msg receivers
+    msg_receiver_ = std::make_shared<MessageReceiver>(Config::traders_addr[Config::partition_idx], ports());
+}
+
+std::vector<int> TraderAckReceiver::ports() {
+    std::vector<int> ports;
+    for (int i = 0; i < Config::exchange_num; i++) {
+        auto& channels = Config::trader_port2exchange_port[Config::partition_idx][i];
+        ASSERT_MSG(ACK_CHANNEL < (int)channels.size(), "no ack channel configured for a trader:exchange link");
+        ports.push_back(channels[ACK_CHANNEL].first);
+    }
+    return ports;
+}
+
+void TraderAckReceiver::stop() {
+    std::cout << "TraderAckReceiver pause" << std::endl;
+    pause_.pause();
+    std::cout << "TraderAckReceiver pause success" << std::endl;
+}
+
+void TraderAckReceiver::restart() {
+    std::cout << "TraderAckReceiver resume" << std::endl;
+    pause_.resume();
+    std::cout << "TraderAckReceiver resume success" << std::endl;
+}
+
+void TraderAckReceiver::reset_network() {
+    // reset msg receiver
+    msg_receiver_->reset_port(ports());
+}
+
+void TraderAckReceiver::run() {
+    pin_thread("ack_receiver");
+    while (!Global<TraderController>::Get() || !Global<TraderController>::Get()->is_inited()) {
+        usleep(1);
+    }
+    logstream(LOG_EMPH) << "Trader AckReceiver is running..." << LOG_endl;
+
+    RecvFrame frame;
+    while (true) {
+        pause_.checkpoint();
+        if (Config::recv_mode == RECV_POLL) {
+            msg_receiver_->poll_drain(frame, [this](RecvFrame& frame) {
+                process_msg(MsgView(frame.data(), frame.size()));
+            }, Config::recv_poll_timeout_ms);
+            continue;
+        }
+
+        if (!msg_receiver_->tryrecv(frame)) {
+            waiter_.idle();
+            continue;
+        }
+        waiter_.reset();
+        process_msg(MsgView(frame.data(), frame.size()));
+    }
+}
+
+void TraderAckReceiver::process_msg(const MsgView& msg) {
+    auto controller = Global<TraderController>::Get();
+    uint32_t msg_code = msg.msg_code();
+    if (msg_code == MSG_TYPE::ORDER_ACK_MSG) {
+        // one ack per stock, carrying the latest order id the exchange has consumed
+        for (const OrderAck& ack : msg.records<OrderAck>()) {
+            controller->update_sliding_window_start(ack.stk_code, ack.order_id + 1);
+        }
+    } else if (msg_code == MSG_TYPE::RESEND_MSG) {
+        for (const OrderAck& resend : msg.records<OrderAck>()) {
+            controller->request_resend(resend.stk_code, resend.order_id);
+        }
+    } else {
+        ASSERT_MSG(false, "Wrong message code!");
+    }
+}
+
+}  // namespace ubiquant
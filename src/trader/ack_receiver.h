@@ -0,0 +1,43 @@
+#pragma once
+
+#include <memory>
+
+#include "common/thread.h"
+#include "common/topology.hpp"
+#include "common/wait_strategy.hpp"
+#include "common/type.hpp"
+#include "network/msg_receiver.h"
+
+namespace ubiquant {
+
+/**
+ * Fast path of the order acks (ACK_CHANNEL of every exchange): moves the sliding window of each
+ * stock forward as soon as the exchange has consumed its orders, however many trades are in flight.
+ * Resend requests come this way too, in order with the acks, and move the window back.
+ */
+class TraderAckReceiver : public ubi_thread {
+   public:
+    TraderAckReceiver();
+
+    void run() override;
+
+    void stop();
+    void restart();
+    void reset_network();
+
+   protected:
+    static std::vector<int> ports();
+
+    // msg is a view over the received frame
+    void process_msg(const MsgView& msg);
+
+    // socket server
+    std::shared_ptr<MessageReceiver> msg_receiver_;
+
+    WaitStrategy waiter_;
+
+    // console pause, checked between messages
+    PauseEpoch pause_;
+};
+
+}  // namespace ubiquant
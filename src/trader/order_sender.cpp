@@ -5,17 +5,24 @@
 
 namespace ubiquant {
 
-TraderOrderSender::TraderOrderSender(int exchange_idx)
-    : exchange_idx_(exchange_idx),
-      order_queue_(Config::sliding_window_size * Config::stock_num / Config::exchange_num) {
+// a window of orders for each stock striped onto this channel
+static int order_queue_capacity(int exchange_idx) {
+    int num_stripes = Config::exchange_num * order_channels(Config::partition_idx, exchange_idx).size();
+    return (Config::stock_num + num_stripes - 1) / num_stripes * Config::sliding_window_size;
+}
 
-    pthread_spin_init(&send_lock, 0);
+TraderOrderSender::TraderOrderSender(int exchange_idx, int channel, int id)
+    : exchange_idx_(exchange_idx),
+      channel_(channel),
+      id_(id),
+      order_queue_(order_queue_capacity(exchange_idx)),
+      msg_buffers_(MsgBuffer::bytes_for<Order>(ORDERS_PER_MSG)),
+      waiter_(Config::send_wait_strategy) {
 
     // init msg sender
     std::pair<int, int> port_pair;
     auto& channels = Config::trader_port2exchange_port[Config::partition_idx][exchange_idx_];
-    // NOTICE: we only use the first channel
-    port_pair = channels[0];
+    port_pair = channels[channel_];
     msg_sender_ = std::make_shared<MessageSender>(
         Config::traders_addr[Config::partition_idx], 
         Config::exchanges_addr[exchange_idx_], 
@@ -23,28 +30,28 @@ TraderOrderSender::TraderOrderSender(int exchange_idx)
 }
 
 void TraderOrderSender::stop() {
-    std::cout << "TraderOrderSender Lock send lock" << std::endl;
-    pthread_spin_lock(&send_lock);
-    std::cout << "TraderOrderSender Lock send lock success" << std::endl;
+    std::cout << "TraderOrderSender pause" << std::endl;
+    pause_.pause();
+    std::cout << "TraderOrderSender pause success" << std::endl;
 }
 
 void TraderOrderSender::restart() {
-    std::cout << "TraderOrderSender Unlock send lock" << std::endl;
-    pthread_spin_unlock(&send_lock);
-    std::cout << "TraderOrderSender Unlock send lock success" << std::endl;
+    std::cout << "TraderOrderSender resume" << std::endl;
+    pause_.resume();
+    std::cout << "TraderOrderSender resume success" << std::endl;
 }
 
 void TraderOrderSender::reset_network() {
     // reset msg sender
     std::pair<int, int> port_pair;
     auto& channels = Config::trader_port2exchange_port[Config::partition_idx][exchange_idx_];
-    // NOTICE: we only use the first channel
-    port_pair = channels[0];
+    port_pair = channels[channel_];
     msg_sender_->reset_port(port_pair);
 }
 
 void TraderOrderSender::run() {
-    logstream(LOG_EMPH) << "Trader OrderSender is running..." << LOG_endl;
+    pin_thread("order_sender", id_);
+    logstream(LOG_EMPH) << "Trader OrderSender [" << exchange_idx_ << ":" << channel_ << "] is running..." << LOG_endl;
     while (!Global<TraderController>::Get() || !Global<TraderController>::Get()->is_inited()) {
         usleep(1);
     }
@@ -52,43 +59,44 @@ void TraderOrderSender::run() {
     // Monitor monitor;
     // monitor.start_thpt();
 
-    std::string order_msg;
-    // order_msg.reserve((Config::sliding_window_size * Config::stock_num / Config::exchange_num+7) * sizeof(Order) + 2 * sizeof(uint32_t));
+    MsgBuffer* order_msg = nullptr;
     while (true) {
-        order_msg.clear();
-        uint32_t msg_code = MSG_TYPE::ORDER_MSG;
-        uint32_t cnt = 0;
-        order_msg.append((char*)&msg_code, sizeof(uint32_t));
-        order_msg.append((char*)&cnt, sizeof(uint32_t));
-        Order order;
-        while (!cnt) {
-            if (!order_queue_.poll(order)) continue;
-            // std::cout << "Send a order:" << std::endl;
-            // order.print();
-            order_msg.append((char*)&order, sizeof(order));
-            cnt++;
-            // monitor.add_cnt();
-            // monitor.print_timely_thpt("Order Sender Throughput");
-            if (cnt >= 100) break;
+        pause_.checkpoint();
+
+        if (order_msg == nullptr) {
+            order_msg = msg_buffers_.acquire(MsgBuffer::bytes_for<Order>(ORDERS_PER_MSG));
+            order_msg->begin(MSG_TYPE::ORDER_MSG);
         }
-        *((uint32_t*)(order_msg.data() + sizeof(uint32_t))) = cnt;
-
-        bool res = false;
-        while (!res) {
-            pthread_spin_lock(&send_lock);
-            res = msg_sender_->send(order_msg);
-            pthread_spin_unlock(&send_lock);
-            // if(unlikely(!res)) {
-            //     std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            // }
+
+        // one lock acquisition for up to ORDERS_PER_MSG orders, written right after the msg header
+        size_t cnt = order_queue_.drain_up_to(order_msg->tail<Order>(), ORDERS_PER_MSG);
+        if (cnt == 0) {
+            // park on the queue itself, put_many() wakes us up
+            if (!waiter_.backoff()) {
+                std::chrono::milliseconds wait_time(1);
+                cnt = order_queue_.drain(order_msg->tail<Order>(), ORDERS_PER_MSG, wait_time);
+            }
+            if (cnt == 0)
+                continue;
+        }
+        waiter_.reset();
+        order_msg->commit<Order>(cnt);
+        // monitor.add_cnt();
+        // monitor.print_timely_thpt("Order Sender Throughput");
+
+        // retry until sent, a paused sender (e.g. while the network is reset) resumes the same message
+        while (!msg_sender_->send(order_msg)) {
+            pause_.checkpoint();
         }
+        order_msg->release();
+        order_msg = nullptr;
     }
 
     // monitor.end_thpt();
 }
 
-void TraderOrderSender::put_order(Order& order) {
-    order_queue_.put(order);
+void TraderOrderSender::put_orders(const std::vector<Order>& orders) {
+    order_queue_.put_many(orders);
 }
 
 }  // namespace ubiquant
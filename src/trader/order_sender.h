@@ -5,6 +5,8 @@
 #include "common/global.hpp"
 #include "common/block_queue.hpp"
 #include "common/thread.h"
+#include "common/topology.hpp"
+#include "common/wait_strategy.hpp"
 #include "common/type.hpp"
 #include "network/msg_sender.h"
 
@@ -12,11 +14,13 @@ namespace ubiquant {
 
 class TraderOrderSender : public ubi_thread {
 public:
-    TraderOrderSender(int exchange_idx);
+    // channel: index of the link channel (see order_channels), id: position among the order senders of this trader
+    TraderOrderSender(int exchange_idx, int channel, int id);
 
     void run() override;
 
-    void put_order(Order& order);
+    // TraderController will call this function with all orders of one round for this exchange
+    void put_orders(const std::vector<Order>& orders);
 
     void stop();
     void restart();
@@ -24,15 +28,23 @@ public:
 
 protected:
     int exchange_idx_;
+    int channel_;
+    int id_;
     
     // socket client
     std::shared_ptr<MessageSender> msg_sender_;
 
     // order queue
+    constexpr static size_t ORDERS_PER_MSG = 100;
     BlockQueue<Order> order_queue_;
 
-    // sender pause lock
-    pthread_spinlock_t send_lock;
+    // orders are drained straight into a pooled message buffer and sent zero-copy
+    MsgBufferPool msg_buffers_;
+
+    WaitStrategy waiter_;
+
+    // console pause, checked between messages
+    PauseEpoch pause_;
 };
 
 }  // namespace ubiquant
@@ -6,9 +6,7 @@
 
 namespace ubiquant {
 
-TraderTradeReceiver::TraderTradeReceiver() {
-
-    pthread_spin_init(&recv_lock, 0);
+TraderTradeReceiver::TraderTradeReceiver() : waiter_(Config::recv_wait_strategy) {
 
     // init stock code (ALL)
     std::vector<int> stk_codes;
@@ -31,6 +29,8 @@ TraderTradeReceiver::TraderTradeReceiver() {
 
         // NOTICE: trade_idx starts from 1
         trade_idxs_[code] = 1;
+        last_trade_order_ids_[code] = 0;
+        skip_trade_order_ids_[code] = 0;
     }
 
     // init msg receivers
@@ -42,15 +42,15 @@ TraderTradeReceiver::TraderTradeReceiver() {
 }
 
 void TraderTradeReceiver::stop() {
-    std::cout << "TraderTradeReceiver Lock recv lock" << std::endl;
-    pthread_spin_lock(&recv_lock);
-    std::cout << "TraderTradeReceiver Lock recv lock success" << std::endl;
+    std::cout << "TraderTradeReceiver pause" << std::endl;
+    pause_.pause();
+    std::cout << "TraderTradeReceiver pause success" << std::endl;
 }
 
 void TraderTradeReceiver::restart() {
-    std::cout << "TraderTradeReceiver unlock recv lock" << std::endl;
-    pthread_spin_unlock(&recv_lock);
-    std::cout << "TraderTradeReceiver unlock recv lock success" << std::endl;
+    std::cout << "TraderTradeReceiver resume" << std::endl;
+    pause_.resume();
+    std::cout << "TraderTradeReceiver resume success" << std::endl;
 }
 
 void TraderTradeReceiver::reset_network() {
@@ -72,64 +72,55 @@ TraderTradeReceiver::~TraderTradeReceiver() {
 }
 
 void TraderTradeReceiver::run() {
+    pin_thread("trade_receiver");
     while (!Global<TraderController>::Get() || !Global<TraderController>::Get()->is_inited()) {
         usleep(1);
     }
     logstream(LOG_EMPH) << "Trader TradeReceiver is running..." << LOG_endl;
 
     monitor.start_thpt();
+    RecvFrame frame;
     while (true) {
-        std::string msg;
-        bool res = false;
-        while (!res) {
-            pthread_spin_lock(&recv_lock);
-            res = msg_receiver_->tryrecv(msg);
-            pthread_spin_unlock(&recv_lock);
-            // if(unlikely(!res)) {
-            //     std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            // }
+        pause_.checkpoint();
+        if (Config::recv_mode == RECV_POLL) {
+            msg_receiver_->poll_drain(frame, [this](RecvFrame& frame) {
+                process_msg(MsgView(frame.data(), frame.size()));
+            }, Config::recv_poll_timeout_ms);
+            continue;
         }
 
-        uint32_t msg_code;
-        size_t offset = 0;
-        get_elem_from_buf(msg.c_str(), offset, msg_code);
-        if (msg_code == MSG_TYPE::ORDER_ACK_MSG) {
-            process_order_ack(msg);
-        } else if (msg_code == MSG_TYPE::TRADE_MSG) {
-            process_trade_result(msg);
-        } else {
-            ASSERT_MSG(false, "Wrong message code!");
+        if (!msg_receiver_->tryrecv(frame)) {
+            waiter_.idle();
+            continue;
         }
-        monitor.print_timely_thpt("Trade Receiver Throughput");
+        waiter_.reset();
+        process_msg(MsgView(frame.data(), frame.size()));
     }
     monitor.end_thpt();
 }
 
-Trade convert_commtrade_to_trade(const CommTrade& commTrade) {
-    return Trade{
-        stk_code : commTrade.stk_code,
-        bid_id : commTrade.bid_id,
-        ask_id : commTrade.ask_id,
-        price : commTrade.price,
-        volume : commTrade.volume
-    };
+void TraderTradeReceiver::process_msg(const MsgView& msg) {
+    uint32_t msg_code = msg.msg_code();
+    if (msg_code == MSG_TYPE::TRADE_MSG) {
+        process_trade_result(msg);
+    } else if (msg_code == MSG_TYPE::RESEND_MSG) {
+        process_resend(msg);
+    } else {
+        ASSERT_MSG(false, "Wrong message code!");
+    }
+    monitor.print_timely_thpt("Trade Receiver Throughput");
 }
 
-void TraderTradeReceiver::process_trade_result(std::string& msg) {
-    // de-serialize
-    std::vector<Trade> trades;
-    size_t offset = sizeof(uint32_t);  // skip msg code
-    uint32_t cnt = 0;
-    get_elem_from_buf(msg.c_str(), offset, cnt);
-    trades.resize(cnt);
-    for (auto& trade : trades) {
-        CommTrade commTrade;
-        get_elem_from_buf(msg.c_str(), offset, commTrade);
-        trade = convert_commtrade_to_trade(commTrade);
+void TraderTradeReceiver::process_trade_result(const MsgView& msg) {
+    for (const CommTrade& comm_trade : msg.records<CommTrade>()) {
         monitor.add_cnt();
-    }
+        // trades of one order never span two messages, so the incoming order id identifies duplicates
+        int order_id = std::max(comm_trade.bid_id, comm_trade.ask_id);
+        if (unlikely(order_id <= skip_trade_order_ids_[comm_trade.stk_code]))
+            continue;
+        last_trade_order_ids_[comm_trade.stk_code] = order_id;
+        Trade trade = convert_commtrade_to_trade(comm_trade);
 
-    for (auto& trade : trades) {
         // trade.print();
         // update hook in controller
         Global<TraderController>::Get()->update_if_hooked(trade.stk_code, trade_idxs_[trade.stk_code], trade.volume);
@@ -147,9 +138,8 @@ void TraderTradeReceiver::process_trade_result(std::string& msg) {
             if (fdatasync(trade_fds_[trade.stk_code]) != 0)
                 throw std::runtime_error("fdatasync trade file error.");
 
+            // keep the capacity, the buffer refills to the same size
             trade_buffer_[trade.stk_code].clear();
-            trade_buffer_[trade.stk_code].shrink_to_fit();
-            trade_buffer_.reserve(TRADE_BUF_THRESHOLD);
         }
     }
 }
@@ -170,20 +160,11 @@ void TraderTradeReceiver::flush() {
     }
 }
 
-void TraderTradeReceiver::process_order_ack(std::string& msg) {
-    // de-serialize
-    std::vector<OrderAck> acks;
-    size_t offset = sizeof(uint32_t);  // skip msg code
-    uint32_t cnt = 0;
-    get_elem_from_buf(msg.c_str(), offset, cnt);
-    acks.resize(cnt);
-    for (auto& ack : acks) {
-        get_elem_from_buf(msg.c_str(), offset, ack);
-    }
-
-    // update sliding window start in controller
-    for (auto& ack : acks) {
-        Global<TraderController>::Get()->update_sliding_window_start(ack.stk_code, ack.order_id + 1);
+void TraderTradeReceiver::process_resend(const MsgView& msg) {
+    // the window is moved back by TraderAckReceiver, which gets the same request in order with the acks
+    for (const OrderAck& resend : msg.records<OrderAck>()) {
+        // the exchange will produce the trades after its snapshot again
+        skip_trade_order_ids_[resend.stk_code] = last_trade_order_ids_[resend.stk_code];
     }
 }
 
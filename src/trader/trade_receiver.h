@@ -7,6 +7,8 @@
 
 #include "common/monitor.hpp"
 #include "common/thread.h"
+#include "common/topology.hpp"
+#include "common/wait_strategy.hpp"
 #include "common/type.hpp"
 #include "network/msg_receiver.h"
 
@@ -28,8 +30,10 @@ class TraderTradeReceiver : public ubi_thread {
     constexpr static size_t FILE_TRUNC_SIZE = 1ul << 30;  // 1GB
     constexpr static size_t TRADE_BUF_THRESHOLD = 100;    // 1GB
 
-    void process_trade_result(std::string& msg);
-    void process_order_ack(std::string& msg);
+    // msg is a view over the received frame
+    void process_msg(const MsgView& msg);
+    void process_trade_result(const MsgView& msg);
+    void process_resend(const MsgView& msg);
     void flush();
 
     // socket server
@@ -39,10 +43,17 @@ class TraderTradeReceiver : public ubi_thread {
     std::unordered_map<int, std::vector<Trade>> trade_buffer_;
     std::unordered_map<int, int> trade_idxs_;
 
+    // incoming order id (the larger of bid_id / ask_id) of the last trade received, per stock
+    std::unordered_map<int, int> last_trade_order_ids_;
+    // after a resend, trades of orders up to this id were already received and are dropped
+    std::unordered_map<int, int> skip_trade_order_ids_;
+
     Monitor monitor;
 
-    // receiver pause lock
-    pthread_spinlock_t recv_lock;
+    WaitStrategy waiter_;
+
+    // console pause, checked between messages
+    PauseEpoch pause_;
 };
 
 }  // namespace ubiquant
@@ -12,14 +12,31 @@ TraderController::TraderController()
     : next_sorted_struct_idx(Config::stock_num, 0), NX_SUB(Config::loader_nx_matrix), NY_SUB(Config::loader_ny_matrix), NZ_SUB(Config::loader_nz_matrix) {
     // init order sender & trade receiver
     trade_receiver_ = std::make_shared<TraderTradeReceiver>();
+    ack_receiver_ = std::make_shared<TraderAckReceiver>();
+    std::vector<int> first_sender(Config::exchange_num);
+    std::vector<int> num_channels(Config::exchange_num);
     for (int i = 0; i < Config::exchange_num; i++) {
-        order_senders_.push_back(std::make_shared<TraderOrderSender>(i));
+        std::vector<int> channels = order_channels(Config::partition_idx, i);
+        ASSERT_MSG(!channels.empty(), "no order channel to exchange");
+        first_sender[i] = order_senders_.size();
+        num_channels[i] = channels.size();
+        for (int channel : channels) {
+            order_senders_.push_back(std::make_shared<TraderOrderSender>(i, channel, order_senders_.size()));
+        }
+    }
+    // NOTICE: stock code starts from 1
+    sender_of_stock_.resize(Config::stock_num + 1);
+    for (int code = 1; code <= Config::stock_num; code++) {
+        int exchange = code % Config::exchange_num;
+        // stocks of one exchange share code % exchange_num, stripe on the rest of the code
+        sender_of_stock_[code] = first_sender[exchange] + (code / Config::exchange_num) % num_channels[exchange];
     }
 
     // start sender & recevier
     trade_receiver_->start();
-    for (int i = 0; i < Config::exchange_num; i++) {
-        order_senders_[i]->start();
+    ack_receiver_->start();
+    for (auto& sender : order_senders_) {
+        sender->start();
     }
 
     // load order data from disk
@@ -27,6 +44,7 @@ TraderController::TraderController()
     count[1] = NY_SUB;
     count[2] = NZ_SUB;
     load_data();
+    HugePages::get().report("Trader[" + std::to_string(Config::partition_idx) + "]");
 
     // init shared info
     sharedInfo = std::make_shared<SharedTradeInfo>(hooked_trade);
@@ -42,6 +60,7 @@ void TraderController::stop_sender() {
 
 void TraderController::stop_receiver() {
     trade_receiver_->stop();
+    ack_receiver_->stop();
 }
 
 void TraderController::restart() {
@@ -49,10 +68,12 @@ void TraderController::restart() {
         sender->restart();
     }
     trade_receiver_->restart();
+    ack_receiver_->restart();
 }
 
 void TraderController::reset_network() {
     trade_receiver_->reset_network();
+    ack_receiver_->reset_network();
 
     for (auto& sender : order_senders_) {
         sender->reset_network();
@@ -65,6 +86,11 @@ void TraderController::update_sliding_window_start(const stock_code_t stock_code
     sharedInfo->update_sliding_window_start(stock_code, new_sliding_window_start);
 }
 
+void TraderController::request_resend(const stock_code_t stock_code, const order_id_t resend_order_id) {
+    std::cout << "Resend stock " << stock_code << " from order " << resend_order_id << std::endl;
+    sharedInfo->request_resend(stock_code, resend_order_id);
+}
+
 void TraderController::update_if_hooked(const stock_code_t stock_code, const trade_idx_t trade_idx, const volume_t volume) {
     sharedInfo->update_if_hooked(stock_code, trade_idx, volume);
 }
@@ -161,12 +187,22 @@ bool TraderController::check_order(Order& order, order_id_t order_id_upper_limit
 }
 
 void TraderController::run_all_in_memory() {
-    std::vector<Order> order_to_send;
-    order_to_send.reserve(Config::stock_num * (Config::sliding_window_size + 7));
+    // orders of one round, grouped by order sender
+    std::vector<std::vector<Order>> order_to_send(order_senders_.size());
+    for (auto& orders : order_to_send)
+        orders.reserve(Config::stock_num * (Config::sliding_window_size + 7) / order_senders_.size());
     while (work_flag) {
-        order_to_send.clear();
+        for (auto& orders : order_to_send)
+            orders.clear();
 
         for (int t = 0; t < Config::stock_num; t++) {
+            // exchange recovered from a snapshot, restart this stock from the resend point
+            if (order_id_t resend_order_id = sharedInfo->take_resend(t + 1)) {
+                auto& structs = sorted_order_structs[t];
+                next_sorted_struct_idx[t] = std::lower_bound(structs.begin(), structs.end(), resend_order_id,
+                    [](const SortStruct& ss, order_id_t id) { return ss.order_id < id; }) - structs.begin();
+            }
+
             // sending order with id less than order_id_limits
             uint64_t order_id_limits = sharedInfo->get_sliding_window_start(t + 1) + Config::sliding_window_size;
 
@@ -176,14 +212,14 @@ void TraderController::run_all_in_memory() {
                 if (!check_order(order, order_id_limits, t))
                     break;
 
-                order_to_send.push_back(order);
+                order_to_send[sender_of_stock_[order.stk_code]].push_back(order);
             }
         }
 
-        // send order
-        for (auto& order : order_to_send) {
-            int idx = order.stk_code % Config::exchange_num;
-            order_senders_[idx]->put_order(order);
+        // send order, one batch per order sender
+        for (size_t idx = 0; idx < order_senders_.size(); idx++) {
+            if (!order_to_send[idx].empty())
+                order_senders_[idx]->put_orders(order_to_send[idx]);
         }
 
         // release memory
@@ -192,18 +228,34 @@ void TraderController::run_all_in_memory() {
 }
 
 void TraderController::run() {
+    int node = pin_thread("trader_controller");
     if (Config::load_mode == 2) {
+        // the matrices were loaded by the main thread, move them next to the controller
+        size_t n = (size_t)NX_SUB * NY_SUB * NZ_SUB;
+        bind_memory(oim.direction_matrix.get(), n * sizeof(direction_t), node);
+        bind_memory(oim.type_matrix.get(), n * sizeof(type_t), node);
+        bind_memory(oim.price_matrix.get(), n * sizeof(price_t), node);
+        bind_memory(oim.volume_matrix.get(), n * sizeof(volume_t), node);
+        for (auto& structs : sorted_order_structs)
+            bind_memory(structs, node);
         run_all_in_memory();
         return;
     }
 
-    std::vector<Order> order_to_send;
-    order_to_send.reserve(Config::stock_num * (Config::sliding_window_size + 7));
+    // orders of one round, grouped by order sender
+    std::vector<std::vector<Order>> order_to_send(order_senders_.size());
+    for (auto& orders : order_to_send)
+        orders.reserve(Config::stock_num * (Config::sliding_window_size + 7) / order_senders_.size());
     OrderGenerator orderGen;
     while (work_flag) {
-        order_to_send.clear();
+        for (auto& orders : order_to_send)
+            orders.clear();
 
         for (int t = 0; t < Config::stock_num; t++) {
+            // exchange recovered from a snapshot, restart this stock from the resend point
+            if (order_id_t resend_order_id = sharedInfo->take_resend(t + 1))
+                orderGen.rewind(t + 1, resend_order_id);
+
             // sending order with id less than order_id_limits
             uint64_t order_id_limits = sharedInfo->get_sliding_window_start(t + 1) + Config::sliding_window_size;
 
@@ -217,14 +269,14 @@ void TraderController::run() {
                     break;
 
                 orderGen.commit(t + 1);
-                order_to_send.push_back(order);
+                order_to_send[sender_of_stock_[order.stk_code]].push_back(order);
             }
         }
 
-        // send order
-        for (auto& order : order_to_send) {
-            int idx = order.stk_code % Config::exchange_num;
-            order_senders_[idx]->put_order(order);
+        // send order, one batch per order sender
+        for (size_t idx = 0; idx < order_senders_.size(); idx++) {
+            if (!order_to_send[idx].empty())
+                order_senders_[idx]->put_orders(order_to_send[idx]);
         }
 
         // release memory
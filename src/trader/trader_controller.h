@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <unordered_map>
 #include <vector>
@@ -7,7 +8,9 @@
 #include "H5Cpp.h"
 #include "common/config.h"
 #include "common/thread.h"
+#include "common/topology.hpp"
 #include "common/type.hpp"
+#include "trader/ack_receiver.h"
 #include "trader/order_sender.h"
 #include "trader/trade_receiver.h"
 
@@ -16,19 +19,34 @@ namespace ubiquant {
 // Usage: auto sti = std::make_shared<SharedTradeInfo>(hooked_trade);
 class SharedTradeInfo {
     mutable std::mutex m;
-    std::vector<order_id_t> sliding_window_start;
+    // written by the ack receiver only and read every round by the controller, so kept out of the lock
+    std::unique_ptr<std::atomic<order_id_t>[]> sliding_window_start;
+    std::vector<order_id_t> resend_from;
     std::shared_ptr<std::vector<std::unordered_map<trade_idx_t, volume_t>>> hooked_trade;
 
    public:
     void update_sliding_window_start(const stock_code_t stock_code, const order_id_t new_sliding_window_start) {
+        assert(new_sliding_window_start >= sliding_window_start[stock_code - 1].load(std::memory_order_relaxed));
+        sliding_window_start[stock_code - 1].store(new_sliding_window_start, std::memory_order_release);
+    }
+
+    // exchange restarted from a snapshot: move the window back and remember where to resend from
+    void request_resend(const stock_code_t stock_code, const order_id_t resend_order_id) {
         std::lock_guard<std::mutex> guard(m);
-        assert(new_sliding_window_start >= sliding_window_start[stock_code - 1]);
-        sliding_window_start[stock_code - 1] = new_sliding_window_start;
+        resend_from[stock_code - 1] = resend_order_id;
+        sliding_window_start[stock_code - 1].store(resend_order_id, std::memory_order_release);
     }
 
-    order_id_t get_sliding_window_start(const stock_code_t stock_code) const {
+    // return 0 if no resend is pending, else the first order id to resend
+    order_id_t take_resend(const stock_code_t stock_code) {
         std::lock_guard<std::mutex> guard(m);
-        return sliding_window_start[stock_code - 1];
+        order_id_t ret = resend_from[stock_code - 1];
+        resend_from[stock_code - 1] = 0;
+        return ret;
+    }
+
+    order_id_t get_sliding_window_start(const stock_code_t stock_code) const {
+        return sliding_window_start[stock_code - 1].load(std::memory_order_acquire);
     }
 
     void update_if_hooked(const stock_code_t stock_code, const trade_idx_t trade_idx, const volume_t volume) {
@@ -51,7 +69,10 @@ class SharedTradeInfo {
     }
 
     SharedTradeInfo(std::shared_ptr<std::vector<std::unordered_map<trade_idx_t, volume_t>>> in_hooked_trade) : hooked_trade(in_hooked_trade) {
-        sliding_window_start = std::vector<order_id_t>(Config::stock_num, 1);
+        sliding_window_start.reset(new std::atomic<order_id_t>[Config::stock_num]);
+        for (int i = 0; i < Config::stock_num; i++)
+            sliding_window_start[i].store(1, std::memory_order_relaxed);
+        resend_from = std::vector<order_id_t>(Config::stock_num, 0);
     }
 };
 
@@ -76,6 +97,8 @@ class TraderController : public ubi_thread {
 
     void update_if_hooked(const stock_code_t stock_code, const trade_idx_t trade_idx, const volume_t volume);
 
+    void request_resend(const stock_code_t stock_code, const order_id_t resend_order_id);
+
     inline volatile bool is_inited() { return init_finished; }
 
    protected:
@@ -99,7 +122,12 @@ class TraderController : public ubi_thread {
 
     // order sender (exchange_num * channels)
     std::vector<std::shared_ptr<TraderOrderSender>> order_senders_;
+    // stk_code -> index in order_senders_: the owning exchange, then striped over its order channels,
+    // so all orders of a stock go through one channel and keep their order
+    std::vector<int> sender_of_stock_;
 
+    // ack receiver (1)
+    std::shared_ptr<TraderAckReceiver> ack_receiver_;
     // order sender (1)
     std::shared_ptr<TraderTradeReceiver> trade_receiver_;
 